@@ -0,0 +1,94 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "hashmap.h"
+
+template<typename Key, typename Value, typename Hash>
+class BackgroundMaintainer {
+private:
+    inline static const std::chrono::microseconds DEFAULT_BUDGET{200};
+    inline static const std::chrono::milliseconds DEFAULT_INTERVAL{10};
+
+public:
+    BackgroundMaintainer(HashMap<Key, Value, Hash>& map, std::mutex& map_mutex,
+                         std::chrono::microseconds budget = DEFAULT_BUDGET,
+                         std::chrono::milliseconds interval = DEFAULT_INTERVAL);
+    BackgroundMaintainer(const BackgroundMaintainer<Key, Value, Hash>& another) = delete;
+    BackgroundMaintainer<Key, Value, Hash>& operator=(const BackgroundMaintainer<Key, Value, Hash>& another) = delete;
+    ~BackgroundMaintainer();
+
+    void wake();
+
+private:
+    void run();
+
+private:
+    HashMap<Key, Value, Hash>& map_;
+    std::mutex& map_mutex_;
+    std::chrono::microseconds budget_;
+    std::chrono::milliseconds interval_;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    bool woken_;
+    bool stopping_;
+    std::thread thread_;
+
+};
+
+template<typename Key, typename Value, typename Hash>
+BackgroundMaintainer<Key, Value, Hash>::BackgroundMaintainer(HashMap<Key, Value, Hash>& map, std::mutex& map_mutex,
+                                                             std::chrono::microseconds budget,
+                                                             std::chrono::milliseconds interval)
+    : map_(map)
+    , map_mutex_(map_mutex)
+    , budget_(budget)
+    , interval_(interval)
+    , woken_(false)
+    , stopping_(false)
+{
+    thread_ = std::thread([this] { run(); });
+}
+
+template<typename Key, typename Value, typename Hash>
+BackgroundMaintainer<Key, Value, Hash>::~BackgroundMaintainer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    changed_.notify_all();
+    thread_.join();
+}
+
+template<typename Key, typename Value, typename Hash>
+void BackgroundMaintainer<Key, Value, Hash>::wake() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        woken_ = true;
+    }
+    changed_.notify_all();
+}
+
+template<typename Key, typename Value, typename Hash>
+void BackgroundMaintainer<Key, Value, Hash>::run() {
+    for ( ; ; ) {
+        bool pending;
+        {
+            std::lock_guard<std::mutex> lock(map_mutex_);
+            pending = map_.maintenance(budget_);
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!pending) {
+            changed_.wait_for(lock, interval_, [this] { return woken_ || stopping_; });
+            woken_ = false;
+        }
+        if (stopping_) {
+            return;
+        }
+        lock.unlock();
+        std::this_thread::yield();
+    }
+}
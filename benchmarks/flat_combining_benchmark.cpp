@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../flat_combining_map.h"
+
+namespace {
+
+const size_t KEY_COUNT = 100000;
+const size_t OPERATIONS_PER_THREAD = 200000;
+const size_t FIND_PERCENT = 10;
+const size_t LOCK_SHARD_COUNT = 16;
+
+// Draws ranks in [0, count) with probability proportional to 1 / (rank + 1)^skew.
+class ZipfianGenerator {
+public:
+    ZipfianGenerator(size_t count, double skew) : cumulative_(count) {
+        double total = 0;
+        for (size_t rank = 0; rank < count; ++rank) {
+            total += 1.0 / std::pow(static_cast<double>(rank + 1), skew);
+            cumulative_[rank] = total;
+        }
+        for (double& weight : cumulative_) {
+            weight /= total;
+        }
+    }
+
+    template<typename Engine>
+    uint64_t operator()(Engine& engine) const {
+        double point = std::uniform_real_distribution<double>(0, 1)(engine);
+        auto it = std::lower_bound(cumulative_.begin(), cumulative_.end(), point);
+        return static_cast<uint64_t>(std::min<size_t>(it - cumulative_.begin(), cumulative_.size() - 1));
+    }
+
+private:
+    std::vector<double> cumulative_;
+};
+
+class LockShardedMap {
+public:
+    LockShardedMap() {
+        for (size_t index = 0; index < LOCK_SHARD_COUNT; ++index) {
+            shards_.push_back(std::make_unique<Shard>());
+        }
+    }
+
+    void update(uint64_t key, const std::function<void(int64_t&)>& function) {
+        Shard& shard = shard_of(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        function(shard.map[key]);
+    }
+
+    bool find(uint64_t key, int64_t& value) {
+        Shard& shard = shard_of(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) {
+            return false;
+        }
+        value = it->second;
+        return true;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        HashMap<uint64_t, int64_t> map;
+    };
+
+    Shard& shard_of(uint64_t key) {
+        return *shards_[hash_mix(key) % shards_.size()];
+    }
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+template<typename Map>
+double run(Map& map, const ZipfianGenerator& zipfian, size_t thread_count) {
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t thread = 0; thread < thread_count; ++thread) {
+        threads.emplace_back([&map, &zipfian, thread] {
+            std::mt19937_64 engine(thread + 1);
+            std::function<void(int64_t&)> increment = [](int64_t& value) { ++value; };
+            int64_t value;
+            for (size_t operation = 0; operation < OPERATIONS_PER_THREAD; ++operation) {
+                uint64_t key = zipfian(engine);
+                if (engine() % 100 < FIND_PERCENT) {
+                    map.find(key, value);
+                } else {
+                    map.update(key, increment);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return static_cast<double>(thread_count * OPERATIONS_PER_THREAD) / seconds / 1e6;
+}
+
+}  // namespace
+
+int main() {
+    size_t max_threads = std::max<unsigned>(1, std::thread::hardware_concurrency());
+    for (double skew : {0.5, 0.99, 1.2}) {
+        ZipfianGenerator zipfian(KEY_COUNT, skew);
+        for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+            FlatCombiningMap<uint64_t, int64_t> combining;
+            LockShardedMap sharded;
+            double combining_rate = run(combining, zipfian, threads);
+            double sharded_rate = run(sharded, zipfian, threads);
+            std::cout << "zipf " << skew << ", " << threads << " threads: flat combining "
+                      << combining_rate << " Mops/s, " << LOCK_SHARD_COUNT << " locked shards "
+                      << sharded_rate << " Mops/s\n";
+        }
+    }
+}
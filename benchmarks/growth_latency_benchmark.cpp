@@ -0,0 +1,42 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../extendible_hashmap.h"
+#include "../hashmap.h"
+#include "../linear_hashmap.h"
+
+namespace {
+
+const size_t INSERT_COUNT = 1 << 21;
+
+// Times every insert individually, so stop-the-world rehashes show up in the tail.
+template<typename Map>
+void report(const std::string& name) {
+    Map map;
+    std::vector<uint64_t> latencies;
+    latencies.reserve(INSERT_COUNT);
+    for (uint64_t key = 0; key < INSERT_COUNT; ++key) {
+        auto start = std::chrono::steady_clock::now();
+        map.insert({key, key});
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        latencies.push_back(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double fraction) {
+        return latencies[std::min(latencies.size() - 1, static_cast<size_t>(fraction * latencies.size()))];
+    };
+    std::cout << name << ": p50 " << percentile(0.5) << " ns, p99 " << percentile(0.99) << " ns, p99.99 "
+              << percentile(0.9999) << " ns, max " << latencies.back() << " ns\n";
+}
+
+}  // namespace
+
+int main() {
+    report<HashMap<uint64_t, uint64_t>>("HashMap");
+    report<ExtendibleHashMap<uint64_t, uint64_t>>("ExtendibleHashMap");
+    report<LinearHashMap<uint64_t, uint64_t>>("LinearHashMap");
+}
@@ -0,0 +1,44 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../thread_pool.h"
+
+namespace {
+
+const size_t ELEMENT_COUNT = 1 << 24;
+const size_t REPEATS = 5;
+
+double run(Executor& executor, std::vector<double>& data) {
+    auto best = std::chrono::steady_clock::duration::max();
+    for (size_t repeat = 0; repeat < REPEATS; ++repeat) {
+        auto start = std::chrono::steady_clock::now();
+        parallel_for(executor, 0, data.size(), 0, [&data](size_t begin, size_t end) {
+            for (size_t index = begin; index < end; ++index) {
+                data[index] = std::sqrt(data[index] + static_cast<double>(index));
+            }
+        });
+        best = std::min(best, std::chrono::steady_clock::now() - start);
+    }
+    return std::chrono::duration<double, std::milli>(best).count();
+}
+
+}  // namespace
+
+int main() {
+    std::vector<double> data(ELEMENT_COUNT, 1.0);
+    size_t max_threads = std::max<unsigned>(1, std::thread::hardware_concurrency());
+    double baseline = 0;
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        WorkStealingPool pool(threads);
+        double elapsed = run(pool, data);
+        if (threads == 1) {
+            baseline = elapsed;
+        }
+        std::cout << threads << " threads: " << elapsed << " ms, speedup " << baseline / elapsed << "\n";
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "hashmap.h"
+
+struct StringColumn {
+    int32_t* offsets;
+    char* data;
+};
+
+struct ConstStringColumn {
+    const int32_t* offsets;
+    const char* data;
+
+    ConstStringColumn(const int32_t* offsets, const char* data)
+        : offsets(offsets), data(data) {}
+    ConstStringColumn(StringColumn column)
+        : offsets(column.offsets), data(column.data) {}
+};
+
+template<typename T>
+struct ColumnTraits {
+    static_assert(std::is_trivially_copyable_v<T>, "no ColumnTraits specialization for this type");
+
+    using Column = T*;
+    using ConstColumn = const T*;
+
+    static size_t data_bytes(const T&) {
+        return sizeof(T);
+    }
+    static void start(Column) {}
+    static void write(Column column, size_t row, const T& value) {
+        column[row] = value;
+    }
+    static T read(ConstColumn column, size_t row) {
+        return column[row];
+    }
+};
+
+template<>
+struct ColumnTraits<std::string> {
+    using Column = StringColumn;
+    using ConstColumn = ConstStringColumn;
+
+    static size_t data_bytes(const std::string& value) {
+        return value.size();
+    }
+    static void start(Column column) {
+        column.offsets[0] = 0;
+    }
+    static void write(Column column, size_t row, const std::string& value) {
+        int64_t end = static_cast<int64_t>(column.offsets[row]) + static_cast<int64_t>(value.size());
+        if (end > std::numeric_limits<int32_t>::max()) {
+            throw std::length_error("string column exceeds 32-bit offsets");
+        }
+        std::memcpy(column.data + column.offsets[row], value.data(), value.size());
+        column.offsets[row + 1] = static_cast<int32_t>(end);
+    }
+    static std::string read(ConstColumn column, size_t row) {
+        return std::string(column.data + column.offsets[row], column.data + column.offsets[row + 1]);
+    }
+};
+
+template<typename T>
+using Column = typename ColumnTraits<T>::Column;
+
+template<typename T>
+using ConstColumn = typename ColumnTraits<T>::ConstColumn;
+
+struct ColumnSizes {
+    size_t rows = 0;
+    size_t key_bytes = 0;
+    size_t value_bytes = 0;
+};
+
+template<typename Key, typename Value, typename Hash>
+ColumnSizes column_sizes(const HashMap<Key, Value, Hash>& map) {
+    ColumnSizes sizes;
+    sizes.rows = map.size();
+    for (const auto& node : map) {
+        sizes.key_bytes += ColumnTraits<Key>::data_bytes(node.first);
+        sizes.value_bytes += ColumnTraits<Value>::data_bytes(node.second);
+    }
+    return sizes;
+}
+
+template<typename Key, typename Value, typename Hash>
+void export_columns(const HashMap<Key, Value, Hash>& map, Column<Key> keys, Column<Value> values) {
+    ColumnTraits<Key>::start(keys);
+    ColumnTraits<Value>::start(values);
+    size_t row = 0;
+    for (const auto& node : map) {
+        ColumnTraits<Key>::write(keys, row, node.first);
+        ColumnTraits<Value>::write(values, row, node.second);
+        ++row;
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void import_columns(HashMap<Key, Value, Hash>& map, ConstColumn<Key> keys, ConstColumn<Value> values, size_t rows) {
+    map.reserve(map.size() + rows);
+    for (size_t row = 0; row < rows; ++row) {
+        map.insert({ColumnTraits<Key>::read(keys, row), ColumnTraits<Value>::read(values, row)});
+    }
+}
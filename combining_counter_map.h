@@ -0,0 +1,211 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "hashmap.h"
+
+template<typename Key, typename Value = int64_t, typename Hash = std::hash<Key>>
+class CombiningCounterMap {
+private:
+    inline static const size_t DEFAULT_SHARD_COUNT = 16;
+    inline static const size_t DEFAULT_FLUSH_THRESHOLD = 256;
+
+public:
+    using Map = HashMap<Key, Value, Hash>;
+
+private:
+    struct LocalBuffer {
+        std::mutex mutex;
+        Map deltas;
+        bool retired = false;
+
+        explicit LocalBuffer(const Hash& hash) : deltas(hash) {}
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        Map map;
+
+        explicit Shard(const Hash& hash) : map(hash) {}
+    };
+
+    // Maps own their buffers; a thread only keeps weak references, so a destroyed map's buffers
+    // are freed with it and the thread's stale entries are pruned on its next miss.
+    struct LocalRegistry {
+        HashMap<uint64_t, std::weak_ptr<LocalBuffer>> buffers;
+
+        ~LocalRegistry() {
+            for (const auto& entry : buffers) {
+                if (auto buffer = entry.second.lock()) {
+                    std::lock_guard<std::mutex> lock(buffer->mutex);
+                    buffer->retired = true;
+                }
+            }
+        }
+    };
+
+public:
+    explicit CombiningCounterMap(size_t flush_threshold = DEFAULT_FLUSH_THRESHOLD,
+                                 size_t shard_count = DEFAULT_SHARD_COUNT, Hash hash = Hash{});
+    CombiningCounterMap(const CombiningCounterMap<Key, Value, Hash>& another) = delete;
+    CombiningCounterMap<Key, Value, Hash>& operator=(const CombiningCounterMap<Key, Value, Hash>& another) = delete;
+
+    void add(const Key& key, const Value& delta = Value(1));
+    void flush();
+    Map snapshot() const;
+
+    size_t shard_count() const;
+    size_t flush_threshold() const;
+
+private:
+    LocalBuffer& local_buffer();
+    size_t shard_of(const Key& key) const;
+    void merge(Map& deltas);
+
+private:
+    Hash hasher_;
+    size_t flush_threshold_;
+    size_t shard_count_;
+    uint64_t id_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    mutable std::mutex registry_mutex_;
+    std::vector<std::shared_ptr<LocalBuffer>> buffers_;
+
+};
+
+template<typename Key, typename Value, typename Hash>
+CombiningCounterMap<Key, Value, Hash>::CombiningCounterMap(size_t flush_threshold, size_t shard_count, Hash hash)
+    : hasher_(std::move(hash))
+    , flush_threshold_(flush_threshold == 0 ? 1 : flush_threshold)
+    , shard_count_(shard_count == 0 ? 1 : shard_count)
+{
+    static std::atomic<uint64_t> next_id{0};
+    id_ = next_id.fetch_add(1);
+    for (size_t i = 0; i < shard_count_; ++i) {
+        shards_.push_back(std::make_unique<Shard>(hasher_));
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void CombiningCounterMap<Key, Value, Hash>::add(const Key& key, const Value& delta) {
+    LocalBuffer& buffer = local_buffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.deltas[key] += delta;
+    if (buffer.deltas.size() >= flush_threshold_) {
+        merge(buffer.deltas);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void CombiningCounterMap<Key, Value, Hash>::flush() {
+    std::lock_guard<std::mutex> registry_lock(registry_mutex_);
+    for (size_t i = 0; i < buffers_.size(); ) {
+        bool retired;
+        {
+            std::lock_guard<std::mutex> lock(buffers_[i]->mutex);
+            merge(buffers_[i]->deltas);
+            retired = buffers_[i]->retired;
+        }
+        if (retired) {
+            buffers_[i] = std::move(buffers_.back());
+            buffers_.pop_back();
+        } else {
+            ++i;
+        }
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+typename CombiningCounterMap<Key, Value, Hash>::Map CombiningCounterMap<Key, Value, Hash>::snapshot() const {
+    std::lock_guard<std::mutex> registry_lock(registry_mutex_);
+    std::vector<std::unique_lock<std::mutex>> locks;
+    for (const auto& buffer : buffers_) {
+        locks.emplace_back(buffer->mutex);
+    }
+    for (size_t i = 0; i < shard_count_; ++i) {
+        locks.emplace_back(shards_[i]->mutex);
+    }
+
+    Map result(hasher_);
+    size_t total = 0;
+    for (size_t i = 0; i < shard_count_; ++i) {
+        total += shards_[i]->map.size();
+    }
+    result.reserve(total);
+    for (size_t i = 0; i < shard_count_; ++i) {
+        const Map& shard = shards_[i]->map;
+        result.insert(shard.begin(), shard.end());
+    }
+    for (const auto& buffer : buffers_) {
+        const Map& deltas = buffer->deltas;
+        for (const auto& delta : deltas) {
+            result[delta.first] += delta.second;
+        }
+    }
+    return result;
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t CombiningCounterMap<Key, Value, Hash>::shard_count() const {
+    return shard_count_;
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t CombiningCounterMap<Key, Value, Hash>::flush_threshold() const {
+    return flush_threshold_;
+}
+
+template<typename Key, typename Value, typename Hash>
+typename CombiningCounterMap<Key, Value, Hash>::LocalBuffer& CombiningCounterMap<Key, Value, Hash>::local_buffer() {
+    thread_local LocalRegistry registry;
+    const auto& buffers = registry.buffers;
+    auto it = buffers.find(id_);
+    if (it != buffers.end()) {
+        if (auto buffer = it->second.lock()) {
+            return *buffer;
+        }
+    }
+    registry.buffers.extract_if([](const auto& entry) {
+        return entry.second.expired();
+    });
+    auto buffer = std::make_shared<LocalBuffer>(hasher_);
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        buffers_.push_back(buffer);
+    }
+    registry.buffers.insert({id_, buffer});
+    return *buffer;
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t CombiningCounterMap<Key, Value, Hash>::shard_of(const Key& key) const {
+    return hash_mix(static_cast<uint64_t>(hasher_(key))) % shard_count_;
+}
+
+template<typename Key, typename Value, typename Hash>
+void CombiningCounterMap<Key, Value, Hash>::merge(Map& deltas) {
+    if (deltas.empty()) {
+        return;
+    }
+    std::vector<std::vector<std::pair<Key, Value>>> per_shard(shard_count_);
+    const Map& pending = deltas;
+    for (const auto& delta : pending) {
+        per_shard[shard_of(delta.first)].emplace_back(delta.first, delta.second);
+    }
+    for (size_t i = 0; i < shard_count_; ++i) {
+        if (per_shard[i].empty()) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(shards_[i]->mutex);
+        for (const auto& delta : per_shard[i]) {
+            shards_[i]->map[delta.first] += delta.second;
+        }
+    }
+    deltas.clear();
+}
@@ -0,0 +1,294 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "hashmap.h"
+
+struct LoadStats {
+    size_t rows = 0;
+    size_t bytes = 0;
+    double seconds = 0;
+
+    double rows_per_second() const {
+        return seconds > 0 ? rows / seconds : 0;
+    }
+};
+
+template<typename T>
+struct FieldParser {
+    static bool parse(const char* begin, const char* end, T& value) {
+        static_assert(std::is_arithmetic_v<T>, "no FieldParser specialization for this type");
+        auto result = std::from_chars(begin, end, value);
+        return result.ec == std::errc() && result.ptr == end;
+    }
+};
+
+template<>
+struct FieldParser<std::string> {
+    static bool parse(const char* begin, const char* end, std::string& value) {
+        value.assign(begin, end);
+        return true;
+    }
+};
+
+inline const char* find_byte(const char* begin, const char* end, char byte) {
+#if defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi8(byte);
+    for ( ; begin + 16 <= end; begin += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (mask != 0) {
+            return begin + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+    }
+#endif
+    const void* found = std::memchr(begin, byte, end - begin);
+    return found == nullptr ? end : static_cast<const char*>(found);
+}
+
+template<typename Key, typename Value, typename Hash>
+class DelimitedLoader {
+private:
+    inline static const size_t DEFAULT_CHUNK_SIZE = 1 << 22;
+    inline static const size_t MAX_QUEUED_BATCHES = 4;
+
+public:
+    using NodeType = std::pair<const Key, Value>;
+    using Batch = std::vector<NodeType>;
+
+    DelimitedLoader(HashMap<Key, Value, Hash>& map, char delimiter = '\t', size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+    LoadStats load(const std::string& path);
+
+private:
+    void produce(std::FILE* file, size_t file_size);
+    void parse_chunk(const char* begin, const char* end, Batch& batch);
+    void parse_line(const char* begin, const char* end, Batch& batch);
+    void push(Batch batch);
+    bool pop(Batch& batch);
+    void finish_producing(std::exception_ptr error);
+
+private:
+    HashMap<Key, Value, Hash>& map_;
+    char delimiter_;
+    size_t chunk_size_;
+    size_t estimated_rows_;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<Batch> queue_;
+    bool done_;
+    bool cancelled_;
+    std::exception_ptr error_;
+
+};
+
+template<typename Key, typename Value, typename Hash>
+DelimitedLoader<Key, Value, Hash>::DelimitedLoader(HashMap<Key, Value, Hash>& map, char delimiter, size_t chunk_size)
+    : map_(map)
+    , delimiter_(delimiter)
+    , chunk_size_(chunk_size == 0 ? DEFAULT_CHUNK_SIZE : chunk_size)
+    , estimated_rows_(0)
+    , done_(false)
+    , cancelled_(false)
+{}
+
+template<typename Key, typename Value, typename Hash>
+LoadStats DelimitedLoader<Key, Value, Hash>::load(const std::string& path) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        throw std::runtime_error("failed to open " + path);
+    }
+    long end_offset = -1;
+    if (std::fseek(file, 0, SEEK_END) == 0) {
+        end_offset = std::ftell(file);
+    }
+    if (end_offset < 0 || std::fseek(file, 0, SEEK_SET) != 0) {
+        std::fclose(file);
+        throw std::runtime_error("failed to determine the size of " + path);
+    }
+    size_t file_size = static_cast<size_t>(end_offset);
+
+    auto start = std::chrono::steady_clock::now();
+    estimated_rows_ = 0;
+    done_ = false;
+    cancelled_ = false;
+    error_ = nullptr;
+    queue_.clear();
+
+    std::thread producer([this, file, file_size] { produce(file, file_size); });
+    size_t inserted_rows = 0;
+    try {
+        Batch batch;
+        while (pop(batch)) {
+            inserted_rows += batch.size();
+            map_.insert(batch.begin(), batch.end());
+        }
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cancelled_ = true;
+        }
+        changed_.notify_all();
+        producer.join();
+        std::fclose(file);
+        throw;
+    }
+    producer.join();
+    std::fclose(file);
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+
+    LoadStats stats;
+    stats.rows = inserted_rows;
+    stats.bytes = file_size;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+template<typename Key, typename Value, typename Hash>
+void DelimitedLoader<Key, Value, Hash>::produce(std::FILE* file, size_t file_size) {
+    try {
+        std::vector<char> buffer;
+        size_t carried = 0;
+        bool reserved = false;
+        for ( ; ; ) {
+            buffer.resize(carried + chunk_size_);
+            size_t read = std::fread(buffer.data() + carried, 1, chunk_size_, file);
+            size_t filled = carried + read;
+            bool last = read < chunk_size_;
+            if (last && std::ferror(file)) {
+                throw std::runtime_error("failed to read input");
+            }
+
+            const char* begin = buffer.data();
+            const char* end = begin + filled;
+            const char* cut = end;
+            if (!last) {
+                while (cut != begin && cut[-1] != '\n') {
+                    --cut;
+                }
+                if (cut == begin) {
+                    carried = filled;
+                    continue;
+                }
+            }
+
+            Batch batch;
+            parse_chunk(begin, cut, batch);
+            if (!reserved && !batch.empty()) {
+                size_t average_line = std::max<size_t>(1, (cut - begin) / batch.size());
+                std::lock_guard<std::mutex> lock(mutex_);
+                estimated_rows_ = file_size / average_line;
+                reserved = true;
+            }
+            push(std::move(batch));
+
+            if (last) {
+                break;
+            }
+            carried = end - cut;
+            std::memmove(buffer.data(), cut, carried);
+        }
+        finish_producing(nullptr);
+    } catch (...) {
+        finish_producing(std::current_exception());
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void DelimitedLoader<Key, Value, Hash>::parse_chunk(const char* begin, const char* end, Batch& batch) {
+    while (begin < end) {
+        const char* line_end = find_byte(begin, end, '\n');
+        const char* content_end = line_end;
+        if (content_end != begin && content_end[-1] == '\r') {
+            --content_end;
+        }
+        if (content_end != begin) {
+            parse_line(begin, content_end, batch);
+        }
+        begin = line_end + 1;
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void DelimitedLoader<Key, Value, Hash>::parse_line(const char* begin, const char* end, Batch& batch) {
+    const char* key_end = find_byte(begin, end, delimiter_);
+    if (key_end == end) {
+        throw std::runtime_error("missing delimiter in line: " + std::string(begin, end));
+    }
+    const char* value_begin = key_end + 1;
+    const char* value_end = find_byte(value_begin, end, delimiter_);
+
+    Key key;
+    Value value;
+    if (!FieldParser<Key>::parse(begin, key_end, key) || !FieldParser<Value>::parse(value_begin, value_end, value)) {
+        throw std::runtime_error("malformed line: " + std::string(begin, end));
+    }
+    batch.emplace_back(std::move(key), std::move(value));
+}
+
+template<typename Key, typename Value, typename Hash>
+void DelimitedLoader<Key, Value, Hash>::push(Batch batch) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return queue_.size() < MAX_QUEUED_BATCHES || cancelled_; });
+    if (cancelled_) {
+        throw std::runtime_error("load cancelled");
+    }
+    queue_.push_back(std::move(batch));
+    changed_.notify_all();
+}
+
+template<typename Key, typename Value, typename Hash>
+bool DelimitedLoader<Key, Value, Hash>::pop(Batch& batch) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return !queue_.empty() || done_; });
+    if (estimated_rows_ != 0) {
+        size_t estimate = estimated_rows_;
+        estimated_rows_ = 0;
+        lock.unlock();
+        map_.reserve(map_.size() + estimate);
+        lock.lock();
+    }
+    if (queue_.empty()) {
+        return false;
+    }
+    batch = std::move(queue_.front());
+    queue_.pop_front();
+    changed_.notify_all();
+    return true;
+}
+
+template<typename Key, typename Value, typename Hash>
+void DelimitedLoader<Key, Value, Hash>::finish_producing(std::exception_ptr error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!cancelled_) {
+        error_ = error;
+    }
+    done_ = true;
+    changed_.notify_all();
+}
+
+template<typename Key, typename Value, typename Hash>
+LoadStats load_delimited(const std::string& path, HashMap<Key, Value, Hash>& map, char delimiter = '\t') {
+    DelimitedLoader<Key, Value, Hash> loader(map, delimiter);
+    return loader.load(path);
+}
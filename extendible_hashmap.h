@@ -0,0 +1,559 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "hashmap.h"
+
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class ExtendibleHashMap {
+private:
+    inline static const size_t SEGMENT_BITS = 8;
+    inline static const size_t SEGMENT_SLOTS = size_t(1) << SEGMENT_BITS;
+    inline static const size_t MAX_SEGMENT_LOAD = SEGMENT_SLOTS * 7 / 8;
+    inline static const size_t MAX_DEPTH = 64;
+    inline static const size_t DEPTH_SLACK = 8;
+
+public:
+    using NodeType = std::pair<const Key, Value>;
+
+private:
+    struct Slot {
+        uint64_t hash = 0;
+        size_t distance_plus_one = 0;
+        std::optional<NodeType> node;
+    };
+
+    struct Segment {
+        size_t local_depth;
+        size_t position;
+        size_t size = 0;
+        std::vector<Slot> slots;
+
+        Segment(size_t local_depth, size_t position, size_t slot_count = SEGMENT_SLOTS)
+            : local_depth(local_depth), position(position), slots(slot_count) {}
+
+        size_t mask() const {
+            return slots.size() - 1;
+        }
+
+        bool full() const {
+            return size >= slots.size() / SEGMENT_SLOTS * MAX_SEGMENT_LOAD;
+        }
+    };
+
+    template<bool is_const>
+    struct common_iterator {
+        friend class ExtendibleHashMap<Key, Value, Hash>;
+        template<bool> friend struct common_iterator;
+    private:
+        using Owner = std::conditional_t<is_const, const ExtendibleHashMap<Key, Value, Hash>, ExtendibleHashMap<Key, Value, Hash>>;
+        Owner* map_;
+        size_t segment_;
+        size_t slot_;
+
+        void skip_empty();
+    public:
+        using difference_type = std::ptrdiff_t;
+        using value_type = std::conditional_t<is_const, const NodeType, NodeType>;
+        using pointer = std::conditional_t<is_const, const NodeType*, NodeType*>;
+        using reference = std::conditional_t<is_const, const NodeType&, NodeType&>;
+        using iterator_category = std::forward_iterator_tag;
+
+        common_iterator();
+        common_iterator(Owner* map, size_t segment, size_t slot);
+        common_iterator(const common_iterator<false>& it);
+        bool operator==(const common_iterator<is_const>& x);
+        bool operator!=(const common_iterator<is_const>& x);
+        reference operator*();
+        pointer operator->();
+        common_iterator<is_const>& operator++();
+        common_iterator<is_const> operator++(int);
+    };
+
+public:
+    using iterator = common_iterator<false>;
+    using const_iterator = common_iterator<true>;
+
+    ExtendibleHashMap(Hash hash = Hash{});
+    ExtendibleHashMap(const ExtendibleHashMap<Key, Value, Hash>& another);
+    ExtendibleHashMap<Key, Value, Hash>& operator=(const ExtendibleHashMap<Key, Value, Hash>& another);
+
+    template<typename TIterator>
+    ExtendibleHashMap(TIterator begin, TIterator end, Hash hash = Hash{});
+    ExtendibleHashMap(std::initializer_list<std::pair<const Key, Value>> items, Hash hash = Hash{});
+
+    size_t size() const;
+    bool empty() const;
+    size_t memory_usage() const;
+    size_t global_depth() const;
+    size_t segment_count() const;
+
+    const Hash& hash_function() const;
+
+    // Insert invalidates iterators and may move entries within a segment. A split copies out of the
+    // segment it replaces and retires it untouched, so older references keep reading that copy
+    // instead of freed memory until reclaim().
+    void insert(const NodeType& x);
+    void erase(const Key& key);
+    template <bool is_const>
+    void erase(common_iterator<is_const> iterator);
+
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    iterator find(const Key& key);
+    const_iterator find(const Key& key) const;
+
+    Value& operator[](const Key& key);
+    const Value& at(const Key& key) const;
+
+    void clear();
+    void reclaim();
+
+private:
+    uint64_t mixed_hash(const Key& key) const;
+    size_t directory_index(uint64_t hash) const;
+    std::pair<Segment*, size_t> find_slot(const Key& key, uint64_t hash) const;
+    static void swap_slots(Slot& first, Slot& second);
+    static void place(Segment& segment, uint64_t hash, const NodeType& node);
+    void erase_slot(Segment& segment, size_t index);
+    size_t depth_limit() const;
+    void split(uint64_t hash);
+    void grow_segment(uint64_t hash);
+    void double_directory();
+
+private:
+    Hash hasher_;
+    std::vector<std::unique_ptr<Segment>> segments_;
+    std::vector<std::unique_ptr<Segment>> retired_;
+    std::vector<Segment*> directory_;
+    size_t global_depth_;
+    size_t size_;
+
+};
+
+template<typename Key, typename Value, typename Hash>
+ExtendibleHashMap<Key, Value, Hash>::ExtendibleHashMap(Hash hash)
+    : hasher_(std::move(hash))
+    , global_depth_(0)
+    , size_(0)
+{
+    segments_.push_back(std::make_unique<Segment>(0, 0));
+    directory_.push_back(segments_.back().get());
+}
+
+template<typename Key, typename Value, typename Hash>
+template<typename TIterator>
+ExtendibleHashMap<Key, Value, Hash>::ExtendibleHashMap(TIterator begin, TIterator end, Hash hash)
+    : ExtendibleHashMap(hash)
+{
+    for (auto it = begin; it != end; ++it) {
+        insert(*it);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+ExtendibleHashMap<Key, Value, Hash>::ExtendibleHashMap(std::initializer_list<std::pair<const Key, Value>> items, Hash hash)
+    : ExtendibleHashMap(hash)
+{
+    for (const auto& element : items) {
+        insert(element);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+ExtendibleHashMap<Key, Value, Hash>::ExtendibleHashMap(const ExtendibleHashMap<Key, Value, Hash>& another)
+    : ExtendibleHashMap(another.hasher_)
+{
+    for (const auto& node : another) {
+        insert(node);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+ExtendibleHashMap<Key, Value, Hash>& ExtendibleHashMap<Key, Value, Hash>::operator=(const ExtendibleHashMap<Key, Value, Hash>& another) {
+    if (&another == this) {
+        return *this;
+    }
+    hasher_ = another.hasher_;
+    clear();
+    for (const auto& node : another) {
+        insert(node);
+    }
+    return *this;
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t ExtendibleHashMap<Key, Value, Hash>::size() const {
+    return size_;
+}
+
+template<typename Key, typename Value, typename Hash>
+bool ExtendibleHashMap<Key, Value, Hash>::empty() const {
+    return size_ == 0;
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t ExtendibleHashMap<Key, Value, Hash>::memory_usage() const {
+    size_t bytes = sizeof(*this) + (segments_.capacity() + retired_.capacity()) * sizeof(std::unique_ptr<Segment>)
+        + directory_.capacity() * sizeof(Segment*);
+    for (const auto* segments : {&segments_, &retired_}) {
+        for (const auto& segment : *segments) {
+            bytes += sizeof(Segment) + segment->slots.size() * sizeof(Slot);
+        }
+    }
+    return bytes;
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t ExtendibleHashMap<Key, Value, Hash>::global_depth() const {
+    return global_depth_;
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t ExtendibleHashMap<Key, Value, Hash>::segment_count() const {
+    return segments_.size();
+}
+
+template<typename Key, typename Value, typename Hash>
+const Hash& ExtendibleHashMap<Key, Value, Hash>::hash_function() const {
+    return hasher_;
+}
+
+template<typename Key, typename Value, typename Hash>
+void ExtendibleHashMap<Key, Value, Hash>::insert(const NodeType& x) {
+    uint64_t hash = mixed_hash(x.first);
+    if (find_slot(x.first, hash).first != nullptr) {
+        return;
+    }
+    while (directory_[directory_index(hash)]->full()) {
+        split(hash);
+    }
+    place(*directory_[directory_index(hash)], hash, x);
+    ++size_;
+}
+
+template<typename Key, typename Value, typename Hash>
+void ExtendibleHashMap<Key, Value, Hash>::erase(const Key& key) {
+    auto [segment, index] = find_slot(key, mixed_hash(key));
+    if (segment != nullptr) {
+        erase_slot(*segment, index);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+template <bool is_const>
+void ExtendibleHashMap<Key, Value, Hash>::erase(common_iterator<is_const> iterator) {
+    erase_slot(*segments_[iterator.segment_], iterator.slot_);
+}
+
+template<typename Key, typename Value, typename Hash>
+void ExtendibleHashMap<Key, Value, Hash>::erase_slot(Segment& segment, size_t index) {
+    std::vector<Slot>& slots = segment.slots;
+    slots[index].node.reset();
+    slots[index].distance_plus_one = 0;
+    size_t next = (index + 1) & segment.mask();
+    while (slots[next].distance_plus_one > 1) {
+        swap_slots(slots[index], slots[next]);
+        --slots[index].distance_plus_one;
+        index = next;
+        next = (index + 1) & segment.mask();
+    }
+    --segment.size;
+    --size_;
+}
+
+template<typename Key, typename Value, typename Hash>
+typename ExtendibleHashMap<Key, Value, Hash>::iterator ExtendibleHashMap<Key, Value, Hash>::begin() {
+    iterator it(this, 0, 0);
+    it.skip_empty();
+    return it;
+}
+
+template<typename Key, typename Value, typename Hash>
+typename ExtendibleHashMap<Key, Value, Hash>::iterator ExtendibleHashMap<Key, Value, Hash>::end() {
+    return iterator(this, segments_.size(), 0);
+}
+
+template<typename Key, typename Value, typename Hash>
+typename ExtendibleHashMap<Key, Value, Hash>::const_iterator ExtendibleHashMap<Key, Value, Hash>::begin() const {
+    const_iterator it(this, 0, 0);
+    it.skip_empty();
+    return it;
+}
+
+template<typename Key, typename Value, typename Hash>
+typename ExtendibleHashMap<Key, Value, Hash>::const_iterator ExtendibleHashMap<Key, Value, Hash>::end() const {
+    return const_iterator(this, segments_.size(), 0);
+}
+
+template<typename Key, typename Value, typename Hash>
+typename ExtendibleHashMap<Key, Value, Hash>::iterator ExtendibleHashMap<Key, Value, Hash>::find(const Key& key) {
+    auto [segment, index] = find_slot(key, mixed_hash(key));
+    return segment == nullptr ? end() : iterator(this, segment->position, index);
+}
+
+template<typename Key, typename Value, typename Hash>
+typename ExtendibleHashMap<Key, Value, Hash>::const_iterator ExtendibleHashMap<Key, Value, Hash>::find(const Key& key) const {
+    auto [segment, index] = find_slot(key, mixed_hash(key));
+    return segment == nullptr ? end() : const_iterator(this, segment->position, index);
+}
+
+template<typename Key, typename Value, typename Hash>
+Value& ExtendibleHashMap<Key, Value, Hash>::operator[](const Key& key) {
+    insert({key, Value{}});
+    return find(key)->second;
+}
+
+template<typename Key, typename Value, typename Hash>
+const Value& ExtendibleHashMap<Key, Value, Hash>::at(const Key& key) const {
+    auto it = find(key);
+    if (it == end()) {
+        throw std::out_of_range("out of range");
+    }
+    return it->second;
+}
+
+template<typename Key, typename Value, typename Hash>
+void ExtendibleHashMap<Key, Value, Hash>::clear() {
+    segments_.clear();
+    retired_.clear();
+    directory_.clear();
+    segments_.push_back(std::make_unique<Segment>(0, 0));
+    directory_.push_back(segments_.back().get());
+    global_depth_ = 0;
+    size_ = 0;
+}
+
+template<typename Key, typename Value, typename Hash>
+void ExtendibleHashMap<Key, Value, Hash>::reclaim() {
+    retired_.clear();
+}
+
+template<typename Key, typename Value, typename Hash>
+uint64_t ExtendibleHashMap<Key, Value, Hash>::mixed_hash(const Key& key) const {
+    return hash_mix(static_cast<uint64_t>(hasher_(key)));
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t ExtendibleHashMap<Key, Value, Hash>::directory_index(uint64_t hash) const {
+    return global_depth_ == 0 ? 0 : hash >> (MAX_DEPTH - global_depth_);
+}
+
+template<typename Key, typename Value, typename Hash>
+std::pair<typename ExtendibleHashMap<Key, Value, Hash>::Segment*, size_t>
+        ExtendibleHashMap<Key, Value, Hash>::find_slot(const Key& key, uint64_t hash) const
+{
+    Segment* segment = directory_[directory_index(hash)];
+    size_t index = hash & segment->mask();
+    for (size_t distance = 1; distance <= segment->slots.size(); ++distance) {
+        const Slot& slot = segment->slots[index];
+        if (slot.distance_plus_one < distance) {
+            break;
+        }
+        if (slot.hash == hash && slot.node->first == key) {
+            return {segment, index};
+        }
+        index = (index + 1) & segment->mask();
+    }
+    return {nullptr, 0};
+}
+
+template<typename Key, typename Value, typename Hash>
+void ExtendibleHashMap<Key, Value, Hash>::swap_slots(Slot& first, Slot& second) {
+    std::swap(first.hash, second.hash);
+    std::swap(first.distance_plus_one, second.distance_plus_one);
+    std::optional<NodeType> temporary;
+    if (first.node) {
+        temporary.emplace(std::move(*first.node));
+        first.node.reset();
+    }
+    if (second.node) {
+        first.node.emplace(std::move(*second.node));
+        second.node.reset();
+    }
+    if (temporary) {
+        second.node.emplace(std::move(*temporary));
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void ExtendibleHashMap<Key, Value, Hash>::place(Segment& segment, uint64_t hash, const NodeType& node) {
+    Slot carried;
+    carried.hash = hash;
+    carried.distance_plus_one = 1;
+    carried.node.emplace(node);
+    size_t index = hash & segment.mask();
+    for ( ; ; ) {
+        Slot& slot = segment.slots[index];
+        if (slot.distance_plus_one == 0) {
+            swap_slots(slot, carried);
+            ++segment.size;
+            return;
+        }
+        if (slot.distance_plus_one < carried.distance_plus_one) {
+            swap_slots(slot, carried);
+        }
+        ++carried.distance_plus_one;
+        index = (index + 1) & segment.mask();
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t ExtendibleHashMap<Key, Value, Hash>::depth_limit() const {
+    size_t bits = 0;
+    for (size_t count = size_ / MAX_SEGMENT_LOAD; count != 0; count >>= 1) {
+        ++bits;
+    }
+    return std::min(MAX_DEPTH, bits + DEPTH_SLACK);
+}
+
+template<typename Key, typename Value, typename Hash>
+void ExtendibleHashMap<Key, Value, Hash>::split(uint64_t hash) {
+    Segment* old = directory_[directory_index(hash)];
+    uint64_t differing = 0;
+    for (const auto& slot : old->slots) {
+        if (slot.node) {
+            differing |= slot.hash ^ hash;
+        }
+    }
+    size_t common_prefix = differing == 0 ? MAX_DEPTH : static_cast<size_t>(__builtin_clzll(differing));
+    if (common_prefix >= depth_limit()) {
+        // Splitting would only deepen the directory without separating these keys.
+        grow_segment(hash);
+        return;
+    }
+    if (old->local_depth == global_depth_) {
+        double_directory();
+    }
+
+    size_t depth = old->local_depth + 1;
+    auto low = std::make_unique<Segment>(depth, old->position, old->slots.size());
+    auto high = std::make_unique<Segment>(depth, segments_.size(), old->slots.size());
+    for (const auto& slot : old->slots) {
+        if (slot.node) {
+            Segment& target = (slot.hash >> (MAX_DEPTH - depth)) & 1 ? *high : *low;
+            place(target, slot.hash, *slot.node);
+        }
+    }
+
+    size_t span = size_t(1) << (global_depth_ - old->local_depth);
+    size_t first = directory_index(hash) & ~(span - 1);
+    for (size_t i = 0; i < span; ++i) {
+        directory_[first + i] = i < span / 2 ? low.get() : high.get();
+    }
+    retired_.push_back(std::move(segments_[old->position]));
+    segments_[old->position] = std::move(low);
+    segments_.push_back(std::move(high));
+}
+
+template<typename Key, typename Value, typename Hash>
+void ExtendibleHashMap<Key, Value, Hash>::grow_segment(uint64_t hash) {
+    Segment* old = directory_[directory_index(hash)];
+    auto grown = std::make_unique<Segment>(old->local_depth, old->position, old->slots.size() * 2);
+    for (const auto& slot : old->slots) {
+        if (slot.node) {
+            place(*grown, slot.hash, *slot.node);
+        }
+    }
+    size_t span = size_t(1) << (global_depth_ - old->local_depth);
+    size_t first = directory_index(hash) & ~(span - 1);
+    std::fill(directory_.begin() + first, directory_.begin() + first + span, grown.get());
+    retired_.push_back(std::move(segments_[old->position]));
+    segments_[old->position] = std::move(grown);
+}
+
+template<typename Key, typename Value, typename Hash>
+void ExtendibleHashMap<Key, Value, Hash>::double_directory() {
+    std::vector<Segment*> directory(directory_.size() * 2);
+    for (size_t i = 0; i < directory.size(); ++i) {
+        directory[i] = directory_[i / 2];
+    }
+    directory_.swap(directory);
+    ++global_depth_;
+}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+ExtendibleHashMap<Key, Value, Hash>::common_iterator<is_const>::common_iterator()
+    : map_(nullptr), segment_(0), slot_(0) {}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+ExtendibleHashMap<Key, Value, Hash>::common_iterator<is_const>::
+        common_iterator(Owner* map, size_t segment, size_t slot): map_(map), segment_(segment), slot_(slot) {}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+ExtendibleHashMap<Key, Value, Hash>::common_iterator<is_const>::
+        common_iterator(const common_iterator<false>& it): map_(it.map_), segment_(it.segment_), slot_(it.slot_) {}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+void ExtendibleHashMap<Key, Value, Hash>::common_iterator<is_const>::skip_empty() {
+    while (segment_ < map_->segments_.size() && !map_->segments_[segment_]->slots[slot_].node) {
+        if (++slot_ == map_->segments_[segment_]->slots.size()) {
+            slot_ = 0;
+            ++segment_;
+        }
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+bool ExtendibleHashMap<Key, Value, Hash>::common_iterator<is_const>::
+        operator==(const ExtendibleHashMap<Key, Value, Hash>::common_iterator<is_const>& x) {
+    return segment_ == x.segment_ && slot_ == x.slot_;
+}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+bool ExtendibleHashMap<Key, Value, Hash>::common_iterator<is_const>::
+        operator!=(const ExtendibleHashMap<Key, Value, Hash>::common_iterator<is_const>& x) {
+    return !operator==(x);
+}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+typename ExtendibleHashMap<Key, Value, Hash>::template common_iterator<is_const>::reference
+        ExtendibleHashMap<Key, Value, Hash>::common_iterator<is_const>::operator*() {
+    return *map_->segments_[segment_]->slots[slot_].node;
+}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+typename ExtendibleHashMap<Key, Value, Hash>::template common_iterator<is_const>::pointer
+        ExtendibleHashMap<Key, Value, Hash>::common_iterator<is_const>::operator->() {
+    return &*map_->segments_[segment_]->slots[slot_].node;
+}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+ExtendibleHashMap<Key, Value, Hash>::template common_iterator<is_const>&
+        ExtendibleHashMap<Key, Value, Hash>::common_iterator<is_const>::operator++() {
+    if (++slot_ == map_->segments_[segment_]->slots.size()) {
+        slot_ = 0;
+        ++segment_;
+    }
+    skip_empty();
+    return *this;
+}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+ExtendibleHashMap<Key, Value, Hash>::template common_iterator<is_const>
+        ExtendibleHashMap<Key, Value, Hash>::common_iterator<is_const>::operator++(int) {
+    ExtendibleHashMap<Key, Value, Hash>::common_iterator<is_const> ret = *this;
+    ++*this;
+    return ret;
+}
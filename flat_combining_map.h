@@ -0,0 +1,194 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "hashmap.h"
+
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class FlatCombiningMap {
+private:
+    inline static const size_t PUBLICATION_SLOT_COUNT = 128;
+
+public:
+    using NodeType = std::pair<const Key, Value>;
+    using Map = HashMap<Key, Value, Hash>;
+
+private:
+    enum class Operation {
+        Insert,
+        Erase,
+        Find,
+        Update,
+    };
+
+    enum SlotState : int {
+        FREE,
+        CLAIMED,
+        PENDING,
+        DONE,
+    };
+
+    struct Request {
+        Operation operation;
+        const Key* key;
+        const NodeType* node;
+        const std::function<void(Value&)>* update;
+        Value* result;
+        bool found;
+        std::exception_ptr error;
+    };
+
+    struct alignas(64) PublicationSlot {
+        std::atomic<int> state{FREE};
+        Request request;
+    };
+
+public:
+    explicit FlatCombiningMap(Hash hash = Hash{});
+    FlatCombiningMap(const FlatCombiningMap<Key, Value, Hash>& another) = delete;
+    FlatCombiningMap<Key, Value, Hash>& operator=(const FlatCombiningMap<Key, Value, Hash>& another) = delete;
+
+    void insert(const NodeType& x);
+    void erase(const Key& key);
+    bool find(const Key& key, Value& value);
+    void update(const Key& key, const std::function<void(Value&)>& function);
+
+    size_t size();
+
+    template<typename Function>
+    auto with_map(Function function);
+
+private:
+    bool execute(Request request);
+    PublicationSlot& claim_slot();
+    void combine();
+    void apply(Request& request);
+
+private:
+    Map map_;
+    std::mutex combiner_lock_;
+    std::vector<PublicationSlot> slots_;
+
+};
+
+template<typename Key, typename Value, typename Hash>
+FlatCombiningMap<Key, Value, Hash>::FlatCombiningMap(Hash hash)
+    : map_(std::move(hash))
+    , slots_(PUBLICATION_SLOT_COUNT)
+{}
+
+template<typename Key, typename Value, typename Hash>
+void FlatCombiningMap<Key, Value, Hash>::insert(const NodeType& x) {
+    execute(Request{Operation::Insert, &x.first, &x, nullptr, nullptr, false, nullptr});
+}
+
+template<typename Key, typename Value, typename Hash>
+void FlatCombiningMap<Key, Value, Hash>::erase(const Key& key) {
+    execute(Request{Operation::Erase, &key, nullptr, nullptr, nullptr, false, nullptr});
+}
+
+template<typename Key, typename Value, typename Hash>
+bool FlatCombiningMap<Key, Value, Hash>::find(const Key& key, Value& value) {
+    return execute(Request{Operation::Find, &key, nullptr, nullptr, &value, false, nullptr});
+}
+
+template<typename Key, typename Value, typename Hash>
+void FlatCombiningMap<Key, Value, Hash>::update(const Key& key, const std::function<void(Value&)>& function) {
+    execute(Request{Operation::Update, &key, nullptr, &function, nullptr, false, nullptr});
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t FlatCombiningMap<Key, Value, Hash>::size() {
+    return with_map([](const Map& map) { return map.size(); });
+}
+
+template<typename Key, typename Value, typename Hash>
+template<typename Function>
+auto FlatCombiningMap<Key, Value, Hash>::with_map(Function function) {
+    std::lock_guard<std::mutex> lock(combiner_lock_);
+    combine();
+    return function(static_cast<const Map&>(map_));
+}
+
+template<typename Key, typename Value, typename Hash>
+bool FlatCombiningMap<Key, Value, Hash>::execute(Request request) {
+    PublicationSlot& slot = claim_slot();
+    slot.request = request;
+    slot.state.store(PENDING, std::memory_order_release);
+
+    for ( ; ; ) {
+        if (slot.state.load(std::memory_order_acquire) == DONE) {
+            break;
+        }
+        if (combiner_lock_.try_lock()) {
+            combine();
+            combiner_lock_.unlock();
+            continue;
+        }
+        std::this_thread::yield();
+    }
+
+    bool found = slot.request.found;
+    std::exception_ptr error = std::move(slot.request.error);
+    slot.state.store(FREE, std::memory_order_release);
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return found;
+}
+
+template<typename Key, typename Value, typename Hash>
+typename FlatCombiningMap<Key, Value, Hash>::PublicationSlot& FlatCombiningMap<Key, Value, Hash>::claim_slot() {
+    size_t index = std::hash<std::thread::id>{}(std::this_thread::get_id()) % slots_.size();
+    for ( ; ; index = (index + 1) % slots_.size()) {
+        int expected = FREE;
+        if (slots_[index].state.load(std::memory_order_relaxed) == FREE
+                && slots_[index].state.compare_exchange_strong(expected, CLAIMED, std::memory_order_acquire)) {
+            return slots_[index];
+        }
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void FlatCombiningMap<Key, Value, Hash>::combine() {
+    for (auto& slot : slots_) {
+        if (slot.state.load(std::memory_order_acquire) == PENDING) {
+            try {
+                apply(slot.request);
+            } catch (...) {
+                slot.request.error = std::current_exception();
+            }
+            slot.state.store(DONE, std::memory_order_release);
+        }
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void FlatCombiningMap<Key, Value, Hash>::apply(Request& request) {
+    switch (request.operation) {
+    case Operation::Insert:
+        map_.insert(*request.node);
+        break;
+    case Operation::Erase:
+        map_.erase(*request.key);
+        break;
+    case Operation::Find: {
+        const Map& map = map_;
+        auto it = map.find(*request.key);
+        request.found = it != map.end();
+        if (request.found) {
+            *request.result = it->second;
+        }
+        break;
+    }
+    case Operation::Update:
+        (*request.update)(map_[*request.key]);
+        break;
+    }
+}
@@ -1,13 +1,103 @@
 #pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
 #include <list>
+#include <mutex>
 #include <stdexcept>
+#include <type_traits>
 #include <vector>
 
+#include "hash_mix.h"
+#include "thread_pool.h"
+#include "xor_filter.h"
+
+struct MapDigest {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    MapDigest& operator+=(const MapDigest& x) {
+        uint64_t sum = low + x.low;
+        high += x.high + (sum < low);
+        low = sum;
+        return *this;
+    }
+    MapDigest& operator-=(const MapDigest& x) {
+        uint64_t difference = low - x.low;
+        high -= x.high + (low < x.low);
+        low = difference;
+        return *this;
+    }
+    bool operator==(const MapDigest& x) const {
+        return low == x.low && high == x.high;
+    }
+    bool operator!=(const MapDigest& x) const {
+        return !operator==(x);
+    }
+};
+
+template<typename T, typename = void>
+struct is_std_hashable : std::false_type {};
+
+template<typename T>
+struct is_std_hashable<T, std::void_t<decltype(std::hash<T>{}(std::declval<const T&>()))>> : std::true_type {};
+
+template<typename Value>
+inline constexpr bool is_digestible_v = is_std_hashable<Value>::value || std::is_trivially_copyable_v<Value>;
+
+template<typename Value>
+uint64_t value_digest_hash(const Value& value) {
+    if constexpr (is_std_hashable<Value>::value) {
+        return hash_mix(static_cast<uint64_t>(std::hash<Value>{}(value)));
+    } else if constexpr (!std::is_trivially_copyable_v<Value>) {
+        return 0;
+    } else {
+        uint64_t hash = sizeof(Value);
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        for (size_t offset = 0; offset < sizeof(Value); offset += sizeof(uint64_t)) {
+            uint64_t word = 0;
+            std::memcpy(&word, bytes + offset, std::min(sizeof(uint64_t), sizeof(Value) - offset));
+            hash = hash_mix(hash ^ word);
+        }
+        return hash;
+    }
+}
+
+struct HashMapStats {
+    size_t rehash_count = 0;
+    size_t last_rehash_peak_bytes = 0;
+    size_t peak_rehash_bytes = 0;
+};
+
+template<typename Key, typename Value>
+struct MapDelta {
+    std::vector<std::pair<Key, Value>> added;
+    std::vector<Key> removed;
+    std::vector<std::pair<Key, Value>> changed;
+
+    bool empty() const {
+        return added.empty() && removed.empty() && changed.empty();
+    }
+};
+
 template<typename Key, typename Value, typename Hash = std::hash<Key>>
 class HashMap {
 private:
     inline static const size_t START_BUCKET_COUNT = 37;
     inline static const float MAX_LOAD_FACTOR = 0.6;
+    inline static const size_t DIGEST_RANGE_BITS = 6;
+    inline static const size_t MIN_DIGEST_PENDING = 64;
+    inline static const size_t PROBE_BATCH_SIZE = 16;
+    inline static const size_t PARALLEL_REHASH_MIN_SIZE = 1 << 17;
+    inline static const size_t REHASH_RANGES_PER_THREAD = 4;
+    inline static const float GROWTH_START_LOAD_FACTOR = 0.45;
+    inline static const float SHRINK_LOAD_FACTOR = 0.1;
+    inline static const float SHRUNK_LOAD_FACTOR = 0.3;
+    inline static const size_t MAINTENANCE_STEP = 256;
+    inline static const size_t SCAN_VISITS_PER_ENTRY = 10;
 
 public:
     using NodeType = std::pair<const Key, Value>;
@@ -15,22 +105,30 @@ public:
 private:
     struct BucketItem {
         NodeType data;
-        size_t distance_to_ideal;
-        size_t id_in_table;
+        // Indexed by table slot: one position for table_, one for shadow_table_ during a migration.
+        size_t distance_to_ideal[2] = {0, 0};
+        size_t id_in_table[2] = {0, 0};
+        bool digest_pending = false;
+        size_t digest_pending_position = 0;
     public:
-        BucketItem(NodeType data, size_t distance_to_ideal, size_t id_in_table)
-            : data(data), distance_to_ideal(distance_to_ideal), id_in_table(id_in_table) {}
+        explicit BucketItem(NodeType data) : data(data) {}
     };
 
+    __extension__ using WideHash = unsigned __int128;
     using ListIterator = typename std::list<BucketItem>::iterator;
     using ListConstIterator = typename std::list<BucketItem>::const_iterator;
 
     template<bool is_const>
     struct common_iterator {
         friend class HashMap<Key, Value, Hash>;
+        template<bool> friend struct common_iterator;
     private:
+        using Owner = std::conditional_t<is_const, const HashMap<Key, Value, Hash>, HashMap<Key, Value, Hash>>;
         using InnerListIterator = std::conditional_t<is_const, ListConstIterator, ListIterator>;
+        Owner* map_;
         InnerListIterator inner_iterator_;
+
+        void mark_accessed();
     public:
         using difference_type = std::ptrdiff_t;
         using value_type = std::conditional_t<is_const, const NodeType, NodeType>;
@@ -39,7 +137,7 @@ private:
         using iterator_category = std::forward_iterator_tag;
 
         common_iterator();
-        explicit common_iterator(InnerListIterator it);
+        common_iterator(Owner* map, InnerListIterator it);
         common_iterator(const common_iterator<false>& it);
         bool operator==(const common_iterator<is_const>& x);
         bool operator!=(const common_iterator<is_const>& x);
@@ -63,19 +161,34 @@ private:
 
     size_t size() const;
     bool empty() const;
+    size_t memory_usage() const;
+    HashMapStats stats() const;
+    // Verifies every entry's table position and probe distance; meant for tests.
+    bool check_invariants() const;
+
+    void reserve(size_t count);
 
     const Hash& hash_function() const;
 
     void insert(const NodeType& x);
+    template<typename TIterator>
+    void insert(TIterator begin, TIterator end);
 
     void erase(const Key& key);
     template <bool is_const>
     void erase(common_iterator<is_const> iterator);
 
+    template <bool is_const>
+    NodeType extract(common_iterator<is_const> iterator);
+    template<typename Predicate>
+    std::vector<NodeType> extract_if(Predicate predicate);
+
     iterator begin();
     iterator end();
     const_iterator begin() const;
     const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
 
     iterator find(const Key& key);
     const_iterator find(const Key& key) const;
@@ -85,14 +198,82 @@ private:
 
     void clear();
 
+    XorFilter<Key, Hash> build_filter() const;
+
+    bool operator==(const HashMap<Key, Value, Hash>& another) const;
+    bool operator!=(const HashMap<Key, Value, Hash>& another) const;
+
+    MapDelta<Key, Value> diff(const HashMap<Key, Value, Hash>& target) const;
+    void apply(const MapDelta<Key, Value>& delta);
+
+    // Entries dereferenced through a mutable iterator (operator[], find, non-const loops) are
+    // re-hashed lazily; iterate with cbegin() or std::as_const to keep a loop out of the digest.
+    // digest() and digest_ranges() may be called from concurrent const readers.
+    void enable_digest();
+    void disable_digest();
+    bool digest_enabled() const;
+    MapDigest digest() const;
+    std::vector<MapDigest> digest_ranges() const;
+
+    // Moves entries into a resized table for up to budget; returns true while work remains.
+    bool maintenance(std::chrono::microseconds budget);
+
+    // Visits entries in mixed-hash order starting at cursor and returns the cursor to resume from,
+    // or 0 once the scan is complete. Entries present for the whole scan are visited exactly once,
+    // even if the table is resized between calls.
+    template<typename Function>
+    uint64_t scan(uint64_t cursor, size_t count, Function function) const;
+
 private:
+    ListIterator find_item(const Key& key, size_t key_hash) const;
+    ListIterator find_from_home(const Key& key, size_t home) const;
+    bool same_layout(const HashMap<Key, Value, Hash>& another) const;
+    void insert_hashed(const NodeType& x, size_t key_hash);
+    void place(ListIterator item, size_t hash);
+    void place_into(std::vector<ListIterator>& table, size_t slot, ListIterator item, size_t hash);
+    void remove_from(std::vector<ListIterator>& table, size_t slot, size_t hash);
     void rehash_if_needed();
+    void rehash(size_t min_bucket_count);
+    void parallel_place(Executor& executor);
+    static size_t next_prime(size_t count);
+    static size_t bucket_index(size_t key_hash, size_t bucket_count);
+    static uint64_t bucket_lower_bound(size_t bucket, size_t bucket_count);
+
+    bool migrating() const;
+    void start_migration(size_t bucket_count);
+    void migrate_step(size_t count);
+    void shadow_place(ListIterator item, size_t hash);
+    void shadow_erase(ListIterator item);
+    void finish_migration();
+    void cancel_migration();
+    void record_rehash(size_t transient_bytes);
+
+    MapDigest entry_digest(const NodeType& node, size_t& range) const;
+    void digest_add(const BucketItem& item) const;
+    void digest_remove(const BucketItem& item) const;
+    void digest_mark_pending(ListIterator it);
+    void digest_forget(ListIterator it);
+    void digest_invalidate();
+    void settle_digest() const;
+    void reset_digest(bool enabled);
 
 private:
     Hash hasher_;
     std::list<BucketItem> items_;
     std::vector<ListIterator> table_;
 
+    bool digest_enabled_;
+    mutable std::mutex digest_mutex_;
+    mutable bool digest_dirty_;
+    mutable std::vector<MapDigest> digest_ranges_;
+    mutable std::vector<ListIterator> digest_pending_;
+
+    size_t table_slot_;
+    std::vector<ListIterator> shadow_table_;
+    ListIterator migration_cursor_;
+
+    HashMapStats stats_;
+
 };
 
 template<typename Key, typename Value, typename Hash>
@@ -100,6 +281,10 @@ HashMap<Key, Value, Hash>::HashMap(Hash hash)
     : hasher_(std::move(hash))
     , items_(std::list<BucketItem>{})
     , table_(std::vector<ListIterator>(START_BUCKET_COUNT, items_.end()))
+    , digest_enabled_(false)
+    , digest_dirty_(false)
+    , table_slot_(0)
+    , migration_cursor_(items_.end())
 {}
 
 template<typename Key, typename Value, typename Hash>
@@ -126,7 +311,12 @@ HashMap<Key, Value, Hash>::HashMap(const HashMap<Key, Value, Hash>& another)
     : hasher_(another.hasher_)
     , items_(std::list<BucketItem>{})
     , table_(std::vector<ListIterator>(another.table_.size(), items_.end()))
+    , digest_enabled_(false)
+    , digest_dirty_(false)
+    , table_slot_(0)
+    , migration_cursor_(items_.end())
 {
+    reset_digest(another.digest_enabled_);
     for (const auto& node : another) {
         insert(node);
     }
@@ -137,6 +327,8 @@ HashMap<Key, Value, Hash>& HashMap<Key, Value, Hash>::operator=(const HashMap<Ke
     if (&another == this) {
         return *this;
     }
+    reset_digest(another.digest_enabled_);
+    cancel_migration();
     hasher_ = another.hasher_;
     items_.clear();
     table_.clear();
@@ -158,6 +350,52 @@ bool HashMap<Key, Value, Hash>::empty() const {
     return size() == 0;
 }
 
+template<typename Key, typename Value, typename Hash>
+size_t HashMap<Key, Value, Hash>::memory_usage() const {
+    size_t node_size = sizeof(BucketItem) + 2 * sizeof(void*);
+    return sizeof(*this) + items_.size() * node_size + table_.capacity() * sizeof(ListIterator)
+        + shadow_table_.capacity() * sizeof(ListIterator);
+}
+
+template<typename Key, typename Value, typename Hash>
+HashMapStats HashMap<Key, Value, Hash>::stats() const {
+    return stats_;
+}
+
+template<typename Key, typename Value, typename Hash>
+bool HashMap<Key, Value, Hash>::check_invariants() const {
+    size_t bucket_count = table_.size();
+    size_t occupied = 0;
+    for (size_t hash = 0; hash < bucket_count; ++hash) {
+        ListIterator next = table_[(hash + 1) % bucket_count];
+        size_t next_distance = next == items_.end() ? 0 : next->distance_to_ideal[table_slot_];
+        if (table_[hash] == items_.end()) {
+            if (next_distance != 0) {
+                return false;
+            }
+            continue;
+        }
+        const BucketItem& item = *table_[hash];
+        size_t home = bucket_index(hasher_(item.data.first), bucket_count);
+        if (item.id_in_table[table_slot_] != hash
+                || item.distance_to_ideal[table_slot_] != (hash + bucket_count - home) % bucket_count
+                || next_distance > item.distance_to_ideal[table_slot_] + 1) {
+            return false;
+        }
+        ++occupied;
+    }
+    return occupied == size();
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::reserve(size_t count) {
+    if (static_cast<double>(count + 1) / table_.size() < MAX_LOAD_FACTOR) {
+        return;
+    }
+    size_t needed = static_cast<size_t>((count + 1) / MAX_LOAD_FACTOR) + 1;
+    rehash(std::max(needed, table_.size() * 2));
+}
+
 template<typename Key, typename Value, typename Hash>
 const Hash& HashMap<Key, Value, Hash>::hash_function() const {
     return hasher_;
@@ -165,31 +403,79 @@ const Hash& HashMap<Key, Value, Hash>::hash_function() const {
 
 template<typename Key, typename Value, typename Hash>
 void HashMap<Key, Value, Hash>::insert(const NodeType& x) {
-    if (find(x.first) != end()) {
+    insert_hashed(x, hasher_(x.first));
+}
+
+template<typename Key, typename Value, typename Hash>
+template<typename TIterator>
+void HashMap<Key, Value, Hash>::insert(TIterator begin, TIterator end) {
+    using Category = typename std::iterator_traits<TIterator>::iterator_category;
+    if constexpr (std::is_base_of_v<std::forward_iterator_tag, Category>) {
+        reserve(size() + static_cast<size_t>(std::distance(begin, end)));
+    }
+    for (auto it = begin; it != end; ++it) {
+        insert(*it);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::insert_hashed(const NodeType& x, size_t key_hash) {
+    if (find_item(x.first, key_hash) != items_.end()) {
         return;
     }
     rehash_if_needed();
 
-    auto list_iterator = items_.emplace(items_.end(), x, 0, 0);
-    size_t hash = hasher_(x.first) % table_.size();
+    if (migrating() && size() + 1 >= shadow_table_.size() * MAX_LOAD_FACTOR) {
+        cancel_migration();
+    }
+    place(items_.emplace(items_.end(), x), bucket_index(key_hash, table_.size()));
+    if (migrating() && migration_cursor_ == items_.end()) {
+        migration_cursor_ = std::prev(items_.end());
+    }
 
-    while (table_[hash] != items_.end()) {
-        if (table_[hash]->distance_to_ideal < list_iterator->distance_to_ideal) {
-            std::swap(list_iterator, table_[hash]);
-            table_[hash]->id_in_table = hash;
+    if (digest_enabled_ && !digest_dirty_) {
+        digest_add(items_.back());
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::place(ListIterator item, size_t hash) {
+    place_into(table_, table_slot_, item, hash);
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::place_into(std::vector<ListIterator>& table, size_t slot, ListIterator item, size_t hash) {
+    item->distance_to_ideal[slot] = 0;
+    while (table[hash] != items_.end()) {
+        if (table[hash]->distance_to_ideal[slot] < item->distance_to_ideal[slot]) {
+            std::swap(item, table[hash]);
+            table[hash]->id_in_table[slot] = hash;
         }
-        ++list_iterator->distance_to_ideal;
-        hash = (hash + 1) % table_.size();
+        ++item->distance_to_ideal[slot];
+        hash = (hash + 1) % table.size();
+    }
+    table[hash] = item;
+    item->id_in_table[slot] = hash;
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::remove_from(std::vector<ListIterator>& table, size_t slot, size_t hash) {
+    table[hash] = items_.end();
+    size_t next_hash = (hash + 1) % table.size();
+    while (table[next_hash] != items_.end() && table[next_hash]->distance_to_ideal[slot] > 0) {
+        std::swap(table[hash], table[next_hash]);
+        table[hash]->id_in_table[slot] = hash;
+        --table[hash]->distance_to_ideal[slot];
+        hash = next_hash;
+        next_hash = (hash + 1) % table.size();
     }
-    table_[hash] = list_iterator;
-    table_[hash]->id_in_table = hash;
 }
 
 template<typename Key, typename Value, typename Hash>
 void HashMap<Key, Value, Hash>::erase(const Key& key) {
-    auto it = find(key);
-    if (it != end()) {
-        erase(it);
+    auto item = find_item(key, hasher_(key));
+    if (item != items_.end()) {
+        erase(iterator(this, item));
     }
 }
 
@@ -197,65 +483,131 @@ template<typename Key, typename Value, typename Hash>
 template <bool is_const>
 void HashMap<Key, Value, Hash>::erase(common_iterator<is_const> iterator) {
     auto inner_iter = iterator.inner_iterator_;
-    size_t hash = inner_iter->id_in_table;
+    size_t hash = inner_iter->id_in_table[table_slot_];
+    if (migrating()) {
+        if (migration_cursor_ == inner_iter) {
+            ++migration_cursor_;
+        } else {
+            shadow_erase(inner_iter);
+        }
+    }
+    if (digest_enabled_ && !digest_dirty_) {
+        auto item = table_[hash];
+        if (item->digest_pending) {
+            digest_forget(item);
+        } else {
+            digest_remove(*item);
+        }
+    }
     items_.erase(inner_iter);
-    table_[hash] = items_.end();
-    size_t next_hash = (hash + 1) % table_.size();
-    while (table_[next_hash] != items_.end() && table_[next_hash]->distance_to_ideal > 0) {
-        std::swap(table_[hash], table_[next_hash]);
-        table_[hash]->id_in_table = hash;
-        --table_[hash]->distance_to_ideal;
-        hash = next_hash;
-        next_hash = (hash + 1) % table_.size();
+    remove_from(table_, table_slot_, hash);
+}
+
+template<typename Key, typename Value, typename Hash>
+template <bool is_const>
+typename HashMap<Key, Value, Hash>::NodeType HashMap<Key, Value, Hash>::extract(common_iterator<is_const> iterator) {
+    NodeType node = iterator.inner_iterator_->data;
+    erase(iterator);
+    return node;
+}
+
+template<typename Key, typename Value, typename Hash>
+template<typename Predicate>
+std::vector<typename HashMap<Key, Value, Hash>::NodeType> HashMap<Key, Value, Hash>::extract_if(Predicate predicate) {
+    std::vector<NodeType> extracted;
+    auto list_it = items_.begin();
+    while (list_it != items_.end()) {
+        auto temp_it = list_it;
+        ++list_it;
+        if (predicate(static_cast<const NodeType&>(temp_it->data))) {
+            extracted.push_back(extract(iterator(this, temp_it)));
+        }
     }
+    return extracted;
 }
 
 template<typename Key, typename Value, typename Hash>
 typename HashMap<Key, Value, Hash>::iterator
         HashMap<Key, Value, Hash>::begin() {
-    return iterator(items_.begin());
+    return iterator(this, items_.begin());
 }
 
 template<typename Key, typename Value, typename Hash>
 typename HashMap<Key, Value, Hash>::iterator
         HashMap<Key, Value, Hash>::end() {
-    return iterator(items_.end());
+    return iterator(this, items_.end());
 }
 
 template<typename Key, typename Value, typename Hash>
 typename HashMap<Key, Value, Hash>::const_iterator
         HashMap<Key, Value, Hash>::begin() const {
-    return const_iterator(items_.begin());
+    return const_iterator(this, items_.begin());
 }
 
 template<typename Key, typename Value, typename Hash>
 typename HashMap<Key, Value, Hash>::const_iterator
         HashMap<Key, Value, Hash>::end() const {
-    return const_iterator(items_.end());
+    return const_iterator(this, items_.end());
+}
+
+template<typename Key, typename Value, typename Hash>
+typename HashMap<Key, Value, Hash>::const_iterator
+        HashMap<Key, Value, Hash>::cbegin() const {
+    return begin();
+}
+
+template<typename Key, typename Value, typename Hash>
+typename HashMap<Key, Value, Hash>::const_iterator
+        HashMap<Key, Value, Hash>::cend() const {
+    return end();
 }
 
 template<typename Key, typename Value, typename Hash>
 typename HashMap<Key, Value, Hash>::const_iterator
         HashMap<Key, Value, Hash>::find(const Key& key) const
 {
-    size_t hash = hasher_(key) % table_.size();
-
-    while (!(table_[hash] == items_.end() || table_[hash]->data.first == key)) {
-        hash = (hash + 1) % table_.size();
-    }
-    return const_iterator(table_[hash]);
+    return const_iterator(this, find_item(key, hasher_(key)));
 }
 
 template<typename Key, typename Value, typename Hash>
 typename HashMap<Key, Value, Hash>::iterator
         HashMap<Key, Value, Hash>::find(const Key& key)
 {
-    size_t hash = hasher_(key) % table_.size();
+    return iterator(this, find_item(key, hasher_(key)));
+}
+
+template<typename Key, typename Value, typename Hash>
+typename HashMap<Key, Value, Hash>::ListIterator
+        HashMap<Key, Value, Hash>::find_item(const Key& key, size_t key_hash) const
+{
+    size_t hash = bucket_index(key_hash, table_.size());
 
     while (!(table_[hash] == items_.end() || table_[hash]->data.first == key)) {
         hash = (hash + 1) % table_.size();
     }
-    return iterator(table_[hash]);
+    return table_[hash];
+}
+
+template<typename Key, typename Value, typename Hash>
+typename HashMap<Key, Value, Hash>::ListIterator
+        HashMap<Key, Value, Hash>::find_from_home(const Key& key, size_t home) const
+{
+    size_t hash = home;
+    for (size_t distance = 0; distance < table_.size(); ++distance) {
+        if (table_[hash] == items_.end() || table_[hash]->distance_to_ideal[table_slot_] < distance) {
+            break;
+        }
+        if (table_[hash]->data.first == key) {
+            return table_[hash];
+        }
+        hash = (hash + 1) % table_.size();
+    }
+    return const_cast<std::list<BucketItem>&>(items_).end();
+}
+
+template<typename Key, typename Value, typename Hash>
+bool HashMap<Key, Value, Hash>::same_layout(const HashMap<Key, Value, Hash>& another) const {
+    return std::is_empty_v<Hash> && table_.size() == another.table_.size();
 }
 
 template<typename Key, typename Value, typename Hash>
@@ -279,52 +631,532 @@ void HashMap<Key, Value, Hash>::clear() {
     while (list_it != items_.end()) {
         auto temp_it = list_it;
         ++list_it;
-        erase(iterator{temp_it});
+        erase(iterator(this, temp_it));
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+XorFilter<Key, Hash> HashMap<Key, Value, Hash>::build_filter() const {
+    std::vector<uint64_t> key_hashes;
+    key_hashes.reserve(size());
+    for (const auto& item : items_) {
+        key_hashes.push_back(hasher_(item.data.first));
+    }
+    return XorFilter<Key, Hash>(std::move(key_hashes), hasher_);
+}
+
+template<typename Key, typename Value, typename Hash>
+bool HashMap<Key, Value, Hash>::operator==(const HashMap<Key, Value, Hash>& another) const {
+    if (&another == this) {
+        return true;
+    }
+    if (size() != another.size()) {
+        return false;
+    }
+    if (std::is_empty_v<Hash> && digest_enabled_ && another.digest_enabled_ && digest() != another.digest()) {
+        return false;
+    }
+
+    if (same_layout(another)) {
+        size_t bucket_count = table_.size();
+        for (size_t hash = 0; hash < bucket_count; ++hash) {
+            if (table_[hash] == items_.end()) {
+                continue;
+            }
+            const BucketItem& item = *table_[hash];
+            size_t home = (hash + bucket_count - item.distance_to_ideal[table_slot_]) % bucket_count;
+            auto match = another.find_from_home(item.data.first, home);
+            if (match == another.items_.end() || !(match->data.second == item.data.second)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const BucketItem* batch[PROBE_BATCH_SIZE];
+    size_t hashes[PROBE_BATCH_SIZE];
+    auto it = items_.begin();
+    while (it != items_.end()) {
+        size_t count = 0;
+        for ( ; count < PROBE_BATCH_SIZE && it != items_.end(); ++count, ++it) {
+            batch[count] = &*it;
+            hashes[count] = another.hasher_(it->data.first);
+            __builtin_prefetch(&another.table_[bucket_index(hashes[count], another.table_.size())]);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            auto match = another.find_item(batch[i]->data.first, hashes[i]);
+            if (match == another.items_.end() || !(match->data.second == batch[i]->data.second)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template<typename Key, typename Value, typename Hash>
+bool HashMap<Key, Value, Hash>::operator!=(const HashMap<Key, Value, Hash>& another) const {
+    return !operator==(another);
+}
+
+template<typename Key, typename Value, typename Hash>
+MapDelta<Key, Value> HashMap<Key, Value, Hash>::diff(const HashMap<Key, Value, Hash>& target) const {
+    MapDelta<Key, Value> delta;
+    if (same_layout(target)) {
+        size_t bucket_count = table_.size();
+        for (size_t hash = 0; hash < bucket_count; ++hash) {
+            if (table_[hash] != items_.end()) {
+                const BucketItem& item = *table_[hash];
+                size_t home = (hash + bucket_count - item.distance_to_ideal[table_slot_]) % bucket_count;
+                auto match = target.find_from_home(item.data.first, home);
+                if (match == target.items_.end()) {
+                    delta.removed.push_back(item.data.first);
+                } else if (!(match->data.second == item.data.second)) {
+                    delta.changed.emplace_back(match->data.first, match->data.second);
+                }
+            }
+            if (target.table_[hash] != target.items_.end()) {
+                const BucketItem& item = *target.table_[hash];
+                size_t home = (hash + bucket_count - item.distance_to_ideal[target.table_slot_]) % bucket_count;
+                if (find_from_home(item.data.first, home) == items_.end()) {
+                    delta.added.emplace_back(item.data.first, item.data.second);
+                }
+            }
+        }
+        return delta;
+    }
+
+    for (const auto& node : *this) {
+        auto match = target.find(node.first);
+        if (match == target.end()) {
+            delta.removed.push_back(node.first);
+        } else if (!(match->second == node.second)) {
+            delta.changed.emplace_back(match->first, match->second);
+        }
+    }
+    for (const auto& node : target) {
+        if (find(node.first) == end()) {
+            delta.added.emplace_back(node.first, node.second);
+        }
+    }
+    return delta;
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::apply(const MapDelta<Key, Value>& delta) {
+    for (const auto& key : delta.removed) {
+        erase(key);
+    }
+    reserve(size() + delta.added.size());
+    for (const auto& node : delta.added) {
+        insert({node.first, node.second});
+    }
+    for (const auto& node : delta.changed) {
+        auto it = find(node.first);
+        if (it == end()) {
+            insert({node.first, node.second});
+        } else {
+            it->second = node.second;
+        }
     }
 }
 
+template<typename Key, typename Value, typename Hash>
+MapDelta<Key, Value> diff(const HashMap<Key, Value, Hash>& source, const HashMap<Key, Value, Hash>& target) {
+    return source.diff(target);
+}
+
 template<typename Key, typename Value, typename Hash>
 void HashMap<Key, Value, Hash>::rehash_if_needed() {
     if (static_cast<double>(size() + 1) / table_.size() < MAX_LOAD_FACTOR) {
         return;
     }
+    if (migrating()) {
+        finish_migration();
+        if (static_cast<double>(size() + 1) / table_.size() < MAX_LOAD_FACTOR) {
+            return;
+        }
+    }
+    rehash(table_.size() * 2);
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::rehash(size_t min_bucket_count) {
+    cancel_migration();
+    std::vector<ListIterator>().swap(table_);
+    table_.assign(next_prime(min_bucket_count), items_.end());
+
+    if (size() >= PARALLEL_REHASH_MIN_SIZE) {
+        Executor& executor = default_executor();
+        if (executor.concurrency() > 1) {
+            parallel_place(executor);
+            return;
+        }
+    }
+    for (auto it = items_.begin(); it != items_.end(); ++it) {
+        place(it, bucket_index(hasher_(it->data.first), table_.size()));
+    }
+    record_rehash(0);
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::parallel_place(Executor& executor) {
+    size_t bucket_count = table_.size();
+    std::vector<ListIterator> entries;
+    entries.reserve(size());
+    for (auto it = items_.begin(); it != items_.end(); ++it) {
+        entries.push_back(it);
+    }
+    std::vector<size_t> homes(entries.size());
+    parallel_for(executor, 0, entries.size(), 0, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            homes[i] = bucket_index(hasher_(entries[i]->data.first), bucket_count);
+        }
+    });
+
+    size_t range_count = std::min(bucket_count, executor.concurrency() * REHASH_RANGES_PER_THREAD);
+    auto range_begin = [bucket_count, range_count](size_t range) {
+        return (range * bucket_count + range_count - 1) / range_count;
+    };
+    std::vector<size_t> offsets(range_count + 1, 0);
+    for (size_t home : homes) {
+        ++offsets[home * range_count / bucket_count + 1];
+    }
+    for (size_t range = 0; range < range_count; ++range) {
+        offsets[range + 1] += offsets[range];
+    }
+    std::vector<size_t> order(entries.size());
+    std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < homes.size(); ++i) {
+        order[cursor[homes[i] * range_count / bucket_count]++] = i;
+    }
+
+    std::vector<std::vector<std::pair<ListIterator, size_t>>> overflow(range_count);
+    parallel_for(executor, 0, range_count, 1, [&](size_t first_range, size_t last_range) {
+        for (size_t range = first_range; range < last_range; ++range) {
+            size_t end = range_begin(range + 1);
+            for (size_t k = offsets[range]; k < offsets[range + 1]; ++k) {
+                ListIterator item = entries[order[k]];
+                size_t hash = homes[order[k]];
+                item->distance_to_ideal[table_slot_] = 0;
+                while (hash < end && table_[hash] != items_.end()) {
+                    if (table_[hash]->distance_to_ideal[table_slot_] < item->distance_to_ideal[table_slot_]) {
+                        std::swap(item, table_[hash]);
+                        table_[hash]->id_in_table[table_slot_] = hash;
+                    }
+                    ++item->distance_to_ideal[table_slot_];
+                    ++hash;
+                }
+                if (hash == end) {
+                    overflow[range].emplace_back(item, end - item->distance_to_ideal[table_slot_]);
+                } else {
+                    table_[hash] = item;
+                    item->id_in_table[table_slot_] = hash;
+                }
+            }
+        }
+    });
+
+    size_t transient_bytes = entries.capacity() * sizeof(ListIterator)
+        + (homes.capacity() + order.capacity() + offsets.capacity() + cursor.capacity()) * sizeof(size_t);
+    for (const auto& spilled : overflow) {
+        transient_bytes += spilled.capacity() * sizeof(std::pair<ListIterator, size_t>);
+        for (const auto& [item, home] : spilled) {
+            place(item, home);
+        }
+    }
+    record_rehash(transient_bytes);
+}
 
-    size_t min_bucket_count = table_.size() * 2;
-    for ( ; ; ++min_bucket_count) {
+template<typename Key, typename Value, typename Hash>
+size_t HashMap<Key, Value, Hash>::next_prime(size_t count) {
+    for ( ; ; ++count) {
         bool prime = true;
-        for (size_t div = 2; div * div <= min_bucket_count; ++div) {
-            if (min_bucket_count % div == 0) {
+        for (size_t div = 2; div * div <= count; ++div) {
+            if (count % div == 0) {
                 prime = false;
                 break;
             }
         }
         if (prime) break;
     }
+    return count;
+}
 
-    auto old_items = std::move(items_);
-    items_.clear();
+template<typename Key, typename Value, typename Hash>
+size_t HashMap<Key, Value, Hash>::bucket_index(size_t key_hash, size_t bucket_count) {
+    uint64_t mixed = hash_mix(static_cast<uint64_t>(key_hash));
+    return static_cast<size_t>((static_cast<WideHash>(mixed) * bucket_count) >> 64);
+}
 
-    table_.clear();
-    table_.resize(min_bucket_count, items_.end());
+template<typename Key, typename Value, typename Hash>
+uint64_t HashMap<Key, Value, Hash>::bucket_lower_bound(size_t bucket, size_t bucket_count) {
+    return static_cast<uint64_t>(((static_cast<WideHash>(bucket) << 64) + bucket_count - 1) / bucket_count);
+}
 
-    for (const auto& item : old_items) {
-        insert(item.data);
+template<typename Key, typename Value, typename Hash>
+template<typename Function>
+uint64_t HashMap<Key, Value, Hash>::scan(uint64_t cursor, size_t count, Function function) const {
+    size_t bucket_count = table_.size();
+    size_t home = static_cast<size_t>((static_cast<WideHash>(cursor) * bucket_count) >> 64);
+    count = std::max<size_t>(count, 1);
+    size_t visited = 0;
+    size_t emitted = 0;
+    for ( ; ; ) {
+        size_t hash = home;
+        for (size_t distance = 0; distance < bucket_count; ++distance) {
+            if (table_[hash] == items_.end() || table_[hash]->distance_to_ideal[table_slot_] < distance) {
+                break;
+            }
+            const BucketItem& item = *table_[hash];
+            if (item.distance_to_ideal[table_slot_] == distance
+                    && (visited > 0 || hash_mix(static_cast<uint64_t>(hasher_(item.data.first))) >= cursor)) {
+                function(static_cast<const NodeType&>(item.data));
+                ++emitted;
+            }
+            hash = (hash + 1) % bucket_count;
+        }
+        ++visited;
+        if (++home == bucket_count) {
+            return 0;
+        }
+        if (emitted >= count || visited >= count * SCAN_VISITS_PER_ENTRY) {
+            return bucket_lower_bound(home, bucket_count);
+        }
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+bool HashMap<Key, Value, Hash>::maintenance(std::chrono::microseconds budget) {
+    auto deadline = std::chrono::steady_clock::now() + budget;
+    if (!migrating()) {
+        if (static_cast<double>(size() + 1) / table_.size() >= GROWTH_START_LOAD_FACTOR) {
+            start_migration(table_.size() * 2);
+        } else if (table_.size() > START_BUCKET_COUNT && size() < table_.size() * SHRINK_LOAD_FACTOR) {
+            start_migration(std::max(START_BUCKET_COUNT, static_cast<size_t>(size() / SHRUNK_LOAD_FACTOR)));
+        } else {
+            return false;
+        }
+    }
+    while (migration_cursor_ != items_.end()) {
+        migrate_step(MAINTENANCE_STEP);
+        if (std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+    }
+    if (migration_cursor_ != items_.end()) {
+        return true;
+    }
+    finish_migration();
+    return false;
+}
+
+template<typename Key, typename Value, typename Hash>
+bool HashMap<Key, Value, Hash>::migrating() const {
+    return !shadow_table_.empty();
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::start_migration(size_t bucket_count) {
+    bucket_count = next_prime(bucket_count);
+    shadow_table_.assign(bucket_count, items_.end());
+    migration_cursor_ = items_.begin();
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::migrate_step(size_t count) {
+    for ( ; count > 0 && migration_cursor_ != items_.end(); --count, ++migration_cursor_) {
+        shadow_place(migration_cursor_, bucket_index(hasher_(migration_cursor_->data.first), shadow_table_.size()));
     }
 }
 
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::shadow_place(ListIterator item, size_t hash) {
+    place_into(shadow_table_, 1 - table_slot_, item, hash);
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::shadow_erase(ListIterator item) {
+    size_t hash = item->id_in_table[1 - table_slot_];
+    if (hash < shadow_table_.size() && shadow_table_[hash] == item) {
+        remove_from(shadow_table_, 1 - table_slot_, hash);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::finish_migration() {
+    migrate_step(size());
+    record_rehash(0);
+    table_.swap(shadow_table_);
+    table_slot_ = 1 - table_slot_;
+    cancel_migration();
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::cancel_migration() {
+    std::vector<ListIterator>().swap(shadow_table_);
+    migration_cursor_ = items_.end();
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::record_rehash(size_t transient_bytes) {
+    size_t peak = memory_usage() + transient_bytes;
+    ++stats_.rehash_count;
+    stats_.last_rehash_peak_bytes = peak;
+    stats_.peak_rehash_bytes = std::max(stats_.peak_rehash_bytes, peak);
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::enable_digest() {
+    static_assert(is_digestible_v<Value>, "digests need std::hash<Value> or a trivially copyable Value");
+    if (!digest_enabled_) {
+        reset_digest(true);
+        digest_dirty_ = true;
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::disable_digest() {
+    reset_digest(false);
+}
+
+template<typename Key, typename Value, typename Hash>
+bool HashMap<Key, Value, Hash>::digest_enabled() const {
+    return digest_enabled_;
+}
+
+template<typename Key, typename Value, typename Hash>
+MapDigest HashMap<Key, Value, Hash>::digest() const {
+    MapDigest total;
+    for (const auto& range : digest_ranges()) {
+        total += range;
+    }
+    return total;
+}
+
+template<typename Key, typename Value, typename Hash>
+std::vector<MapDigest> HashMap<Key, Value, Hash>::digest_ranges() const {
+    if (!digest_enabled_) {
+        throw std::logic_error("digest is not enabled");
+    }
+    std::lock_guard<std::mutex> lock(digest_mutex_);
+    settle_digest();
+    return digest_ranges_;
+}
+
+template<typename Key, typename Value, typename Hash>
+MapDigest HashMap<Key, Value, Hash>::entry_digest(const NodeType& node, size_t& range) const {
+    uint64_t key_hash = hash_mix(static_cast<uint64_t>(hasher_(node.first)));
+    uint64_t value_hash = value_digest_hash(node.second);
+    range = key_hash >> (64 - DIGEST_RANGE_BITS);
+
+    MapDigest digest;
+    digest.low = hash_mix(key_hash ^ (value_hash * 0x9e3779b97f4a7c15ull));
+    digest.high = hash_mix(key_hash + value_hash + 0x632be59bd9b4e019ull);
+    return digest;
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::digest_add(const BucketItem& item) const {
+    size_t range;
+    MapDigest digest = entry_digest(item.data, range);
+    digest_ranges_[range] += digest;
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::digest_remove(const BucketItem& item) const {
+    size_t range;
+    MapDigest digest = entry_digest(item.data, range);
+    digest_ranges_[range] -= digest;
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::digest_mark_pending(ListIterator it) {
+    if (digest_dirty_ || it->digest_pending) {
+        return;
+    }
+    if (digest_pending_.size() >= std::max(MIN_DIGEST_PENDING, size() / 4)) {
+        digest_invalidate();
+        return;
+    }
+    digest_remove(*it);
+    it->digest_pending = true;
+    it->digest_pending_position = digest_pending_.size();
+    digest_pending_.push_back(it);
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::digest_invalidate() {
+    for (auto pending : digest_pending_) {
+        pending->digest_pending = false;
+    }
+    digest_pending_.clear();
+    digest_dirty_ = true;
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::digest_forget(ListIterator it) {
+    it->digest_pending = false;
+    ListIterator last = digest_pending_.back();
+    last->digest_pending_position = it->digest_pending_position;
+    digest_pending_[it->digest_pending_position] = last;
+    digest_pending_.pop_back();
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::settle_digest() const {
+    if (!digest_enabled_) {
+        return;
+    }
+    if (digest_dirty_) {
+        digest_ranges_.assign(size_t{1} << DIGEST_RANGE_BITS, MapDigest{});
+        for (const auto& item : items_) {
+            digest_add(item);
+        }
+        digest_dirty_ = false;
+        return;
+    }
+    for (auto pending : digest_pending_) {
+        pending->digest_pending = false;
+        digest_add(*pending);
+    }
+    digest_pending_.clear();
+}
+
+template<typename Key, typename Value, typename Hash>
+void HashMap<Key, Value, Hash>::reset_digest(bool enabled) {
+    for (auto pending : digest_pending_) {
+        pending->digest_pending = false;
+    }
+    digest_pending_.clear();
+    digest_enabled_ = enabled;
+    digest_dirty_ = false;
+    digest_ranges_.assign(enabled ? size_t{1} << DIGEST_RANGE_BITS : 0, MapDigest{});
+}
+
 template<typename Key, typename Value, typename Hash>
 template<bool is_const>
-HashMap<Key, Value, Hash>::common_iterator<is_const>::common_iterator() {}
+HashMap<Key, Value, Hash>::common_iterator<is_const>::common_iterator() : map_(nullptr) {}
 
 template<typename Key, typename Value, typename Hash>
 template<bool is_const>
 HashMap<Key, Value, Hash>::common_iterator<is_const>::
-        common_iterator(InnerListIterator it): inner_iterator_(it) {}
+        common_iterator(Owner* map, InnerListIterator it): map_(map), inner_iterator_(it) {}
 
 template<typename Key, typename Value, typename Hash>
 template<bool is_const>
 HashMap<Key, Value, Hash>::common_iterator<is_const>::
-        common_iterator(const common_iterator<false>& it): inner_iterator_(it.inner_iterator_) {}
+        common_iterator(const common_iterator<false>& it): map_(it.map_), inner_iterator_(it.inner_iterator_) {}
+
+// A mutable reference may be written through, so the entry's digest is re-hashed lazily.
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+void HashMap<Key, Value, Hash>::common_iterator<is_const>::mark_accessed() {
+    if constexpr (!is_const) {
+        if (map_ != nullptr && map_->digest_enabled_) {
+            map_->digest_mark_pending(inner_iterator_);
+        }
+    }
+}
 
 template<typename Key, typename Value, typename Hash>
 template<bool is_const>
@@ -344,6 +1176,7 @@ template<typename Key, typename Value, typename Hash>
 template<bool is_const>
 typename HashMap<Key, Value, Hash>::template common_iterator<is_const>::reference
         HashMap<Key, Value, Hash>::common_iterator<is_const>::operator*() {
+    mark_accessed();
     return inner_iterator_->data;
 }
 
@@ -351,6 +1184,7 @@ template<typename Key, typename Value, typename Hash>
 template<bool is_const>
 typename HashMap<Key, Value, Hash>::template common_iterator<is_const>::pointer
         HashMap<Key, Value, Hash>::common_iterator<is_const>::operator->() {
+    mark_accessed();
     return &inner_iterator_->data;
 }
 
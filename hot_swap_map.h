@@ -0,0 +1,215 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "hashmap.h"
+
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class HotSwapMap {
+private:
+    inline static const size_t READER_SLOT_COUNT = 128;
+    inline static const uint64_t IDLE = std::numeric_limits<uint64_t>::max();
+    inline static const std::chrono::milliseconds RECLAIM_INTERVAL{1};
+
+public:
+    using Map = HashMap<Key, Value, Hash>;
+
+private:
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch{IDLE};
+    };
+
+    struct RetiredMap {
+        std::unique_ptr<Map> map;
+        uint64_t epoch;
+    };
+
+    class ReadGuard {
+    public:
+        explicit ReadGuard(const HotSwapMap<Key, Value, Hash>& owner);
+        ~ReadGuard();
+        const Map& map() const;
+    private:
+        ReaderSlot* slot_;
+        const Map* map_;
+    };
+
+public:
+    explicit HotSwapMap(std::unique_ptr<Map> initial = std::make_unique<Map>());
+    HotSwapMap(const HotSwapMap<Key, Value, Hash>& another) = delete;
+    HotSwapMap<Key, Value, Hash>& operator=(const HotSwapMap<Key, Value, Hash>& another) = delete;
+    ~HotSwapMap();
+
+    void publish(std::unique_ptr<Map> next);
+
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    size_t size() const;
+
+    template<typename Function>
+    auto read(Function function) const;
+
+    size_t retired_count() const;
+
+private:
+    ReaderSlot& acquire_slot() const;
+    uint64_t oldest_reader_epoch() const;
+    void reclaim_loop();
+
+private:
+    std::atomic<Map*> current_;
+    std::atomic<uint64_t> epoch_;
+    mutable std::vector<ReaderSlot> readers_;
+
+    mutable std::mutex retired_mutex_;
+    std::condition_variable retired_changed_;
+    std::vector<RetiredMap> retired_;
+    bool stopping_;
+    std::thread reclaimer_;
+
+};
+
+template<typename Key, typename Value, typename Hash>
+HotSwapMap<Key, Value, Hash>::ReadGuard::ReadGuard(const HotSwapMap<Key, Value, Hash>& owner)
+    : slot_(&owner.acquire_slot())
+    , map_(owner.current_.load())
+{}
+
+template<typename Key, typename Value, typename Hash>
+HotSwapMap<Key, Value, Hash>::ReadGuard::~ReadGuard() {
+    slot_->epoch.store(IDLE, std::memory_order_release);
+}
+
+template<typename Key, typename Value, typename Hash>
+const typename HotSwapMap<Key, Value, Hash>::Map& HotSwapMap<Key, Value, Hash>::ReadGuard::map() const {
+    return *map_;
+}
+
+template<typename Key, typename Value, typename Hash>
+HotSwapMap<Key, Value, Hash>::HotSwapMap(std::unique_ptr<Map> initial)
+    : current_(initial.release())
+    , epoch_(0)
+    , readers_(READER_SLOT_COUNT)
+    , stopping_(false)
+{
+    reclaimer_ = std::thread([this] { reclaim_loop(); });
+}
+
+template<typename Key, typename Value, typename Hash>
+HotSwapMap<Key, Value, Hash>::~HotSwapMap() {
+    {
+        std::lock_guard<std::mutex> lock(retired_mutex_);
+        stopping_ = true;
+    }
+    retired_changed_.notify_all();
+    reclaimer_.join();
+    retired_.clear();
+    delete current_.load();
+}
+
+template<typename Key, typename Value, typename Hash>
+void HotSwapMap<Key, Value, Hash>::publish(std::unique_ptr<Map> next) {
+    Map* previous = current_.exchange(next.release());
+    uint64_t retire_epoch = epoch_.fetch_add(1) + 1;
+    {
+        std::lock_guard<std::mutex> lock(retired_mutex_);
+        retired_.push_back(RetiredMap{std::unique_ptr<Map>(previous), retire_epoch});
+    }
+    retired_changed_.notify_all();
+}
+
+template<typename Key, typename Value, typename Hash>
+bool HotSwapMap<Key, Value, Hash>::find(const Key& key, Value& value) const {
+    ReadGuard guard(*this);
+    auto it = guard.map().find(key);
+    if (it == guard.map().end()) {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+template<typename Key, typename Value, typename Hash>
+bool HotSwapMap<Key, Value, Hash>::contains(const Key& key) const {
+    ReadGuard guard(*this);
+    return guard.map().find(key) != guard.map().end();
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t HotSwapMap<Key, Value, Hash>::size() const {
+    ReadGuard guard(*this);
+    return guard.map().size();
+}
+
+template<typename Key, typename Value, typename Hash>
+template<typename Function>
+auto HotSwapMap<Key, Value, Hash>::read(Function function) const {
+    ReadGuard guard(*this);
+    return function(guard.map());
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t HotSwapMap<Key, Value, Hash>::retired_count() const {
+    std::lock_guard<std::mutex> lock(retired_mutex_);
+    return retired_.size();
+}
+
+template<typename Key, typename Value, typename Hash>
+typename HotSwapMap<Key, Value, Hash>::ReaderSlot& HotSwapMap<Key, Value, Hash>::acquire_slot() const {
+    size_t index = std::hash<std::thread::id>{}(std::this_thread::get_id()) % readers_.size();
+    for ( ; ; index = (index + 1) % readers_.size()) {
+        uint64_t expected = IDLE;
+        if (readers_[index].epoch.compare_exchange_strong(expected, epoch_.load())) {
+            return readers_[index];
+        }
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+uint64_t HotSwapMap<Key, Value, Hash>::oldest_reader_epoch() const {
+    uint64_t oldest = IDLE;
+    for (const auto& reader : readers_) {
+        oldest = std::min(oldest, reader.epoch.load());
+    }
+    return oldest;
+}
+
+template<typename Key, typename Value, typename Hash>
+void HotSwapMap<Key, Value, Hash>::reclaim_loop() {
+    std::unique_lock<std::mutex> lock(retired_mutex_);
+    while (!stopping_) {
+        if (retired_.empty()) {
+            retired_changed_.wait(lock, [this] { return stopping_ || !retired_.empty(); });
+            continue;
+        }
+
+        uint64_t oldest = oldest_reader_epoch();
+        std::vector<RetiredMap> reclaimable;
+        for (size_t i = 0; i < retired_.size(); ) {
+            if (retired_[i].epoch <= oldest) {
+                reclaimable.push_back(std::move(retired_[i]));
+                retired_[i] = std::move(retired_.back());
+                retired_.pop_back();
+            } else {
+                ++i;
+            }
+        }
+
+        lock.unlock();
+        reclaimable.clear();
+        lock.lock();
+        if (!retired_.empty()) {
+            retired_changed_.wait_for(lock, RECLAIM_INTERVAL);
+        }
+    }
+}
@@ -0,0 +1,422 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "hashmap.h"
+
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class LinearHashMap {
+private:
+    inline static const size_t START_BUCKET_COUNT = 16;
+    inline static const float MAX_LOAD_FACTOR = 1.0;
+
+public:
+    using NodeType = std::pair<const Key, Value>;
+
+private:
+    struct Entry {
+        uint64_t hash;
+        std::optional<NodeType> node;
+    };
+
+    using Bucket = std::vector<Entry>;
+
+    template<bool is_const>
+    struct common_iterator {
+        friend class LinearHashMap<Key, Value, Hash>;
+        template<bool> friend struct common_iterator;
+    private:
+        using Owner = std::conditional_t<is_const, const LinearHashMap<Key, Value, Hash>, LinearHashMap<Key, Value, Hash>>;
+        Owner* map_;
+        size_t bucket_;
+        size_t entry_;
+
+        void skip_empty();
+    public:
+        using difference_type = std::ptrdiff_t;
+        using value_type = std::conditional_t<is_const, const NodeType, NodeType>;
+        using pointer = std::conditional_t<is_const, const NodeType*, NodeType*>;
+        using reference = std::conditional_t<is_const, const NodeType&, NodeType&>;
+        using iterator_category = std::forward_iterator_tag;
+
+        common_iterator();
+        common_iterator(Owner* map, size_t bucket, size_t entry);
+        common_iterator(const common_iterator<false>& it);
+        bool operator==(const common_iterator<is_const>& x);
+        bool operator!=(const common_iterator<is_const>& x);
+        reference operator*();
+        pointer operator->();
+        common_iterator<is_const>& operator++();
+        common_iterator<is_const> operator++(int);
+    };
+
+public:
+    using iterator = common_iterator<false>;
+    using const_iterator = common_iterator<true>;
+
+    LinearHashMap(Hash hash = Hash{});
+    LinearHashMap(const LinearHashMap<Key, Value, Hash>& another);
+    LinearHashMap<Key, Value, Hash>& operator=(const LinearHashMap<Key, Value, Hash>& another);
+
+    template<typename TIterator>
+    LinearHashMap(TIterator begin, TIterator end, Hash hash = Hash{});
+    LinearHashMap(std::initializer_list<std::pair<const Key, Value>> items, Hash hash = Hash{});
+
+    size_t size() const;
+    bool empty() const;
+    size_t memory_usage() const;
+    size_t bucket_count() const;
+    size_t level() const;
+    size_t split_pointer() const;
+
+    const Hash& hash_function() const;
+
+    void insert(const NodeType& x);
+    void erase(const Key& key);
+    template <bool is_const>
+    void erase(common_iterator<is_const> iterator);
+
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    iterator find(const Key& key);
+    const_iterator find(const Key& key) const;
+
+    Value& operator[](const Key& key);
+    const Value& at(const Key& key) const;
+
+    void clear();
+
+private:
+    uint64_t mixed_hash(const Key& key) const;
+    size_t bucket_of(uint64_t hash) const;
+    std::pair<size_t, size_t> find_entry(const Key& key, uint64_t hash) const;
+    void erase_entry(size_t bucket_index, size_t entry_index);
+    void split_next();
+
+private:
+    Hash hasher_;
+    std::deque<Bucket> buckets_;
+    size_t level_;
+    size_t split_;
+    size_t size_;
+
+};
+
+template<typename Key, typename Value, typename Hash>
+LinearHashMap<Key, Value, Hash>::LinearHashMap(Hash hash)
+    : hasher_(std::move(hash))
+    , buckets_(START_BUCKET_COUNT)
+    , level_(0)
+    , split_(0)
+    , size_(0)
+{}
+
+template<typename Key, typename Value, typename Hash>
+template<typename TIterator>
+LinearHashMap<Key, Value, Hash>::LinearHashMap(TIterator begin, TIterator end, Hash hash)
+    : LinearHashMap(hash)
+{
+    for (auto it = begin; it != end; ++it) {
+        insert(*it);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+LinearHashMap<Key, Value, Hash>::LinearHashMap(std::initializer_list<std::pair<const Key, Value>> items, Hash hash)
+    : LinearHashMap(hash)
+{
+    for (const auto& element : items) {
+        insert(element);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+LinearHashMap<Key, Value, Hash>::LinearHashMap(const LinearHashMap<Key, Value, Hash>& another)
+    : LinearHashMap(another.hasher_)
+{
+    for (const auto& node : another) {
+        insert(node);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+LinearHashMap<Key, Value, Hash>& LinearHashMap<Key, Value, Hash>::operator=(const LinearHashMap<Key, Value, Hash>& another) {
+    if (&another == this) {
+        return *this;
+    }
+    hasher_ = another.hasher_;
+    clear();
+    for (const auto& node : another) {
+        insert(node);
+    }
+    return *this;
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t LinearHashMap<Key, Value, Hash>::size() const {
+    return size_;
+}
+
+template<typename Key, typename Value, typename Hash>
+bool LinearHashMap<Key, Value, Hash>::empty() const {
+    return size_ == 0;
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t LinearHashMap<Key, Value, Hash>::memory_usage() const {
+    size_t usage = sizeof(*this) + buckets_.size() * sizeof(Bucket);
+    for (const auto& bucket : buckets_) {
+        usage += bucket.capacity() * sizeof(Entry);
+    }
+    return usage;
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t LinearHashMap<Key, Value, Hash>::bucket_count() const {
+    return buckets_.size();
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t LinearHashMap<Key, Value, Hash>::level() const {
+    return level_;
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t LinearHashMap<Key, Value, Hash>::split_pointer() const {
+    return split_;
+}
+
+template<typename Key, typename Value, typename Hash>
+const Hash& LinearHashMap<Key, Value, Hash>::hash_function() const {
+    return hasher_;
+}
+
+template<typename Key, typename Value, typename Hash>
+void LinearHashMap<Key, Value, Hash>::insert(const NodeType& x) {
+    uint64_t hash = mixed_hash(x.first);
+    if (find_entry(x.first, hash).first != buckets_.size()) {
+        return;
+    }
+    Bucket& bucket = buckets_[bucket_of(hash)];
+    bucket.push_back(Entry{hash, std::nullopt});
+    bucket.back().node.emplace(x);
+    ++size_;
+    if (size_ > buckets_.size() * MAX_LOAD_FACTOR) {
+        split_next();
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void LinearHashMap<Key, Value, Hash>::erase(const Key& key) {
+    auto [bucket_index, entry_index] = find_entry(key, mixed_hash(key));
+    if (bucket_index != buckets_.size()) {
+        erase_entry(bucket_index, entry_index);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+template <bool is_const>
+void LinearHashMap<Key, Value, Hash>::erase(common_iterator<is_const> iterator) {
+    erase_entry(iterator.bucket_, iterator.entry_);
+}
+
+template<typename Key, typename Value, typename Hash>
+void LinearHashMap<Key, Value, Hash>::erase_entry(size_t bucket_index, size_t entry_index) {
+    Bucket& bucket = buckets_[bucket_index];
+    Entry& entry = bucket[entry_index];
+    entry.node.reset();
+    if (&entry != &bucket.back()) {
+        entry.hash = bucket.back().hash;
+        entry.node.emplace(std::move(*bucket.back().node));
+    }
+    bucket.pop_back();
+    --size_;
+}
+
+template<typename Key, typename Value, typename Hash>
+typename LinearHashMap<Key, Value, Hash>::iterator LinearHashMap<Key, Value, Hash>::begin() {
+    iterator it(this, 0, 0);
+    it.skip_empty();
+    return it;
+}
+
+template<typename Key, typename Value, typename Hash>
+typename LinearHashMap<Key, Value, Hash>::iterator LinearHashMap<Key, Value, Hash>::end() {
+    return iterator(this, buckets_.size(), 0);
+}
+
+template<typename Key, typename Value, typename Hash>
+typename LinearHashMap<Key, Value, Hash>::const_iterator LinearHashMap<Key, Value, Hash>::begin() const {
+    const_iterator it(this, 0, 0);
+    it.skip_empty();
+    return it;
+}
+
+template<typename Key, typename Value, typename Hash>
+typename LinearHashMap<Key, Value, Hash>::const_iterator LinearHashMap<Key, Value, Hash>::end() const {
+    return const_iterator(this, buckets_.size(), 0);
+}
+
+template<typename Key, typename Value, typename Hash>
+typename LinearHashMap<Key, Value, Hash>::iterator LinearHashMap<Key, Value, Hash>::find(const Key& key) {
+    auto [bucket, entry] = find_entry(key, mixed_hash(key));
+    return iterator(this, bucket, entry);
+}
+
+template<typename Key, typename Value, typename Hash>
+typename LinearHashMap<Key, Value, Hash>::const_iterator LinearHashMap<Key, Value, Hash>::find(const Key& key) const {
+    auto [bucket, entry] = find_entry(key, mixed_hash(key));
+    return const_iterator(this, bucket, entry);
+}
+
+template<typename Key, typename Value, typename Hash>
+Value& LinearHashMap<Key, Value, Hash>::operator[](const Key& key) {
+    insert({key, Value{}});
+    return find(key)->second;
+}
+
+template<typename Key, typename Value, typename Hash>
+const Value& LinearHashMap<Key, Value, Hash>::at(const Key& key) const {
+    auto it = find(key);
+    if (it == end()) {
+        throw std::out_of_range("out of range");
+    }
+    return it->second;
+}
+
+template<typename Key, typename Value, typename Hash>
+void LinearHashMap<Key, Value, Hash>::clear() {
+    buckets_.clear();
+    buckets_.resize(START_BUCKET_COUNT);
+    level_ = 0;
+    split_ = 0;
+    size_ = 0;
+}
+
+template<typename Key, typename Value, typename Hash>
+uint64_t LinearHashMap<Key, Value, Hash>::mixed_hash(const Key& key) const {
+    return hash_mix(static_cast<uint64_t>(hasher_(key)));
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t LinearHashMap<Key, Value, Hash>::bucket_of(uint64_t hash) const {
+    size_t round_size = START_BUCKET_COUNT << level_;
+    size_t bucket = hash & (round_size - 1);
+    if (bucket < split_) {
+        bucket = hash & (2 * round_size - 1);
+    }
+    return bucket;
+}
+
+template<typename Key, typename Value, typename Hash>
+std::pair<size_t, size_t> LinearHashMap<Key, Value, Hash>::find_entry(const Key& key, uint64_t hash) const {
+    size_t bucket_index = bucket_of(hash);
+    const Bucket& bucket = buckets_[bucket_index];
+    for (size_t i = 0; i < bucket.size(); ++i) {
+        if (bucket[i].hash == hash && bucket[i].node->first == key) {
+            return {bucket_index, i};
+        }
+    }
+    return {buckets_.size(), 0};
+}
+
+template<typename Key, typename Value, typename Hash>
+void LinearHashMap<Key, Value, Hash>::split_next() {
+    size_t round_size = START_BUCKET_COUNT << level_;
+    buckets_.emplace_back();
+    Bucket& source = buckets_[split_];
+    Bucket& target = buckets_.back();
+
+    Bucket kept;
+    for (auto& entry : source) {
+        Bucket& destination = (entry.hash & round_size) ? target : kept;
+        destination.push_back(Entry{entry.hash, std::nullopt});
+        destination.back().node.emplace(std::move(*entry.node));
+    }
+    source.swap(kept);
+
+    if (++split_ == round_size) {
+        split_ = 0;
+        ++level_;
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+LinearHashMap<Key, Value, Hash>::common_iterator<is_const>::common_iterator()
+    : map_(nullptr), bucket_(0), entry_(0) {}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+LinearHashMap<Key, Value, Hash>::common_iterator<is_const>::
+        common_iterator(Owner* map, size_t bucket, size_t entry): map_(map), bucket_(bucket), entry_(entry) {}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+LinearHashMap<Key, Value, Hash>::common_iterator<is_const>::
+        common_iterator(const common_iterator<false>& it): map_(it.map_), bucket_(it.bucket_), entry_(it.entry_) {}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+void LinearHashMap<Key, Value, Hash>::common_iterator<is_const>::skip_empty() {
+    while (bucket_ < map_->buckets_.size() && entry_ == map_->buckets_[bucket_].size()) {
+        ++bucket_;
+        entry_ = 0;
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+bool LinearHashMap<Key, Value, Hash>::common_iterator<is_const>::
+        operator==(const LinearHashMap<Key, Value, Hash>::common_iterator<is_const>& x) {
+    return bucket_ == x.bucket_ && entry_ == x.entry_;
+}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+bool LinearHashMap<Key, Value, Hash>::common_iterator<is_const>::
+        operator!=(const LinearHashMap<Key, Value, Hash>::common_iterator<is_const>& x) {
+    return !operator==(x);
+}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+typename LinearHashMap<Key, Value, Hash>::template common_iterator<is_const>::reference
+        LinearHashMap<Key, Value, Hash>::common_iterator<is_const>::operator*() {
+    return *map_->buckets_[bucket_][entry_].node;
+}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+typename LinearHashMap<Key, Value, Hash>::template common_iterator<is_const>::pointer
+        LinearHashMap<Key, Value, Hash>::common_iterator<is_const>::operator->() {
+    return &*map_->buckets_[bucket_][entry_].node;
+}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+LinearHashMap<Key, Value, Hash>::template common_iterator<is_const>&
+        LinearHashMap<Key, Value, Hash>::common_iterator<is_const>::operator++() {
+    ++entry_;
+    skip_empty();
+    return *this;
+}
+
+template<typename Key, typename Value, typename Hash>
+template<bool is_const>
+LinearHashMap<Key, Value, Hash>::template common_iterator<is_const>
+        LinearHashMap<Key, Value, Hash>::common_iterator<is_const>::operator++(int) {
+    LinearHashMap<Key, Value, Hash>::common_iterator<is_const> ret = *this;
+    ++*this;
+    return ret;
+}
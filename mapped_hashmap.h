@@ -0,0 +1,396 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class MappedHashMap {
+private:
+    inline static const uint64_t MAGIC = 0x31504d4853414d4dull;
+    inline static const size_t START_BUCKET_COUNT = 37;
+    inline static const float MAX_LOAD_FACTOR = 0.6;
+
+public:
+    using NodeType = std::pair<const Key, Value>;
+
+private:
+    struct Header {
+        uint64_t magic;
+        uint64_t key_size;
+        uint64_t value_size;
+        uint64_t bucket_count;
+        uint64_t size;
+    };
+
+    struct Slot {
+        uint64_t distance_plus_one;
+        Key key;
+        Value value;
+    };
+
+public:
+    // Holds an exclusive flock on the file, so a second map on the same path fails to open.
+    explicit MappedHashMap(const std::string& path, Hash hash = Hash{});
+    MappedHashMap(const MappedHashMap<Key, Value, Hash>& another) = delete;
+    MappedHashMap<Key, Value, Hash>& operator=(const MappedHashMap<Key, Value, Hash>& another) = delete;
+    ~MappedHashMap();
+
+    size_t size() const;
+    bool empty() const;
+    size_t bucket_count() const;
+
+    const Hash& hash_function() const;
+
+    bool insert(const NodeType& x);
+    void erase(const Key& key);
+
+    Value* find(const Key& key);
+    const Value* find(const Key& key) const;
+    bool contains(const Key& key) const;
+
+    Value& operator[](const Key& key);
+    const Value& at(const Key& key) const;
+
+    template<typename Function>
+    void for_each(Function function) const;
+
+    void clear();
+    void checkpoint();
+
+private:
+    static size_t file_size_for(size_t bucket_count);
+    static size_t next_prime(size_t value);
+
+    Header& header() const;
+    Slot* slots() const;
+    size_t find_index(const Key& key) const;
+    void place(Key key, Value value);
+    void map_file(size_t bytes);
+    void grow(size_t min_bucket_count);
+    void sync_directory() const;
+
+private:
+    Hash hasher_;
+    std::string path_;
+    int fd_;
+    void* region_;
+    size_t region_size_;
+
+};
+
+template<typename Key, typename Value, typename Hash>
+MappedHashMap<Key, Value, Hash>::MappedHashMap(const std::string& path, Hash hash)
+    : hasher_(std::move(hash))
+    , path_(path)
+    , fd_(-1)
+    , region_(MAP_FAILED)
+    , region_size_(0)
+{
+    static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Value>,
+                  "mapped maps require trivially copyable keys and values");
+
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) {
+        throw std::runtime_error("failed to open " + path);
+    }
+    if (::flock(fd_, LOCK_EX | LOCK_NB) != 0) {
+        ::close(fd_);
+        throw std::runtime_error("map file is in use " + path);
+    }
+    struct stat info;
+    if (::fstat(fd_, &info) != 0) {
+        ::close(fd_);
+        throw std::runtime_error("failed to stat " + path);
+    }
+
+    if (info.st_size == 0) {
+        size_t bytes = file_size_for(START_BUCKET_COUNT);
+        if (::ftruncate(fd_, bytes) != 0) {
+            ::close(fd_);
+            throw std::runtime_error("failed to size " + path);
+        }
+        map_file(bytes);
+        header() = Header{MAGIC, sizeof(Key), sizeof(Value), START_BUCKET_COUNT, 0};
+        return;
+    }
+
+    map_file(static_cast<size_t>(info.st_size));
+    const Header& existing = header();
+    if (static_cast<size_t>(info.st_size) < sizeof(Header) || existing.magic != MAGIC
+            || existing.key_size != sizeof(Key) || existing.value_size != sizeof(Value)
+            || file_size_for(existing.bucket_count) > static_cast<size_t>(info.st_size)) {
+        ::munmap(region_, region_size_);
+        ::close(fd_);
+        throw std::runtime_error("incompatible map file " + path);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+MappedHashMap<Key, Value, Hash>::~MappedHashMap() {
+    if (region_ != MAP_FAILED) {
+        ::msync(region_, region_size_, MS_ASYNC);
+        ::munmap(region_, region_size_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t MappedHashMap<Key, Value, Hash>::size() const {
+    return header().size;
+}
+
+template<typename Key, typename Value, typename Hash>
+bool MappedHashMap<Key, Value, Hash>::empty() const {
+    return size() == 0;
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t MappedHashMap<Key, Value, Hash>::bucket_count() const {
+    return header().bucket_count;
+}
+
+template<typename Key, typename Value, typename Hash>
+const Hash& MappedHashMap<Key, Value, Hash>::hash_function() const {
+    return hasher_;
+}
+
+template<typename Key, typename Value, typename Hash>
+bool MappedHashMap<Key, Value, Hash>::insert(const NodeType& x) {
+    if (find_index(x.first) != bucket_count()) {
+        return false;
+    }
+    if (static_cast<double>(size() + 1) / bucket_count() >= MAX_LOAD_FACTOR) {
+        grow(bucket_count() * 2);
+    }
+    place(x.first, x.second);
+    ++header().size;
+    return true;
+}
+
+template<typename Key, typename Value, typename Hash>
+void MappedHashMap<Key, Value, Hash>::erase(const Key& key) {
+    size_t hash = find_index(key);
+    size_t buckets = bucket_count();
+    if (hash == buckets) {
+        return;
+    }
+    Slot* table = slots();
+    table[hash].distance_plus_one = 0;
+    size_t next_hash = (hash + 1) % buckets;
+    while (table[next_hash].distance_plus_one > 1) {
+        table[hash] = table[next_hash];
+        --table[hash].distance_plus_one;
+        table[next_hash].distance_plus_one = 0;
+        hash = next_hash;
+        next_hash = (hash + 1) % buckets;
+    }
+    --header().size;
+}
+
+template<typename Key, typename Value, typename Hash>
+Value* MappedHashMap<Key, Value, Hash>::find(const Key& key) {
+    size_t index = find_index(key);
+    return index == bucket_count() ? nullptr : &slots()[index].value;
+}
+
+template<typename Key, typename Value, typename Hash>
+const Value* MappedHashMap<Key, Value, Hash>::find(const Key& key) const {
+    size_t index = find_index(key);
+    return index == bucket_count() ? nullptr : &slots()[index].value;
+}
+
+template<typename Key, typename Value, typename Hash>
+bool MappedHashMap<Key, Value, Hash>::contains(const Key& key) const {
+    return find_index(key) != bucket_count();
+}
+
+template<typename Key, typename Value, typename Hash>
+Value& MappedHashMap<Key, Value, Hash>::operator[](const Key& key) {
+    insert({key, Value{}});
+    return *find(key);
+}
+
+template<typename Key, typename Value, typename Hash>
+const Value& MappedHashMap<Key, Value, Hash>::at(const Key& key) const {
+    const Value* value = find(key);
+    if (value == nullptr) {
+        throw std::out_of_range("out of range");
+    }
+    return *value;
+}
+
+template<typename Key, typename Value, typename Hash>
+template<typename Function>
+void MappedHashMap<Key, Value, Hash>::for_each(Function function) const {
+    const Slot* table = slots();
+    for (size_t index = 0; index < bucket_count(); ++index) {
+        if (table[index].distance_plus_one != 0) {
+            function(NodeType(table[index].key, table[index].value));
+        }
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void MappedHashMap<Key, Value, Hash>::clear() {
+    Slot* table = slots();
+    for (size_t index = 0; index < bucket_count(); ++index) {
+        table[index].distance_plus_one = 0;
+    }
+    header().size = 0;
+}
+
+template<typename Key, typename Value, typename Hash>
+void MappedHashMap<Key, Value, Hash>::checkpoint() {
+    if (::msync(region_, region_size_, MS_SYNC) != 0) {
+        throw std::runtime_error("msync failed");
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t MappedHashMap<Key, Value, Hash>::file_size_for(size_t bucket_count) {
+    return sizeof(Header) + bucket_count * sizeof(Slot);
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t MappedHashMap<Key, Value, Hash>::next_prime(size_t value) {
+    for ( ; ; ++value) {
+        bool prime = true;
+        for (size_t div = 2; div * div <= value; ++div) {
+            if (value % div == 0) {
+                prime = false;
+                break;
+            }
+        }
+        if (prime) return value;
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+typename MappedHashMap<Key, Value, Hash>::Header& MappedHashMap<Key, Value, Hash>::header() const {
+    return *static_cast<Header*>(region_);
+}
+
+template<typename Key, typename Value, typename Hash>
+typename MappedHashMap<Key, Value, Hash>::Slot* MappedHashMap<Key, Value, Hash>::slots() const {
+    return reinterpret_cast<Slot*>(static_cast<char*>(region_) + sizeof(Header));
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t MappedHashMap<Key, Value, Hash>::find_index(const Key& key) const {
+    size_t buckets = bucket_count();
+    const Slot* table = slots();
+    size_t hash = hasher_(key) % buckets;
+    for (uint64_t distance = 1; ; ++distance) {
+        if (table[hash].distance_plus_one < distance) {
+            return buckets;
+        }
+        if (table[hash].key == key) {
+            return hash;
+        }
+        hash = (hash + 1) % buckets;
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void MappedHashMap<Key, Value, Hash>::place(Key key, Value value) {
+    size_t buckets = bucket_count();
+    Slot* table = slots();
+    Slot current{1, key, value};
+    size_t hash = hasher_(key) % buckets;
+
+    while (table[hash].distance_plus_one != 0) {
+        if (table[hash].distance_plus_one < current.distance_plus_one) {
+            std::swap(current, table[hash]);
+        }
+        ++current.distance_plus_one;
+        hash = (hash + 1) % buckets;
+    }
+    table[hash] = current;
+}
+
+template<typename Key, typename Value, typename Hash>
+void MappedHashMap<Key, Value, Hash>::map_file(size_t bytes) {
+    void* region = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (region == MAP_FAILED) {
+        throw std::runtime_error("failed to map file");
+    }
+    region_ = region;
+    region_size_ = bytes;
+}
+
+template<typename Key, typename Value, typename Hash>
+void MappedHashMap<Key, Value, Hash>::grow(size_t min_bucket_count) {
+    // The bigger table is built in a side file and renamed over the map file, so a crash
+    // mid-grow leaves either the old table or the complete new one on disk.
+    std::string grow_path = path_ + ".grow";
+    int old_fd = fd_;
+    void* old_region = region_;
+    size_t old_region_size = region_size_;
+    const Slot* old_slots = slots();
+    size_t old_bucket_count = bucket_count();
+    uint64_t old_size = size();
+
+    size_t new_bucket_count = next_prime(min_bucket_count);
+    size_t bytes = file_size_for(new_bucket_count);
+    fd_ = ::open(grow_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    region_ = MAP_FAILED;
+    try {
+        if (fd_ < 0 || ::flock(fd_, LOCK_EX | LOCK_NB) != 0 || ::ftruncate(fd_, bytes) != 0) {
+            throw std::runtime_error("failed to grow map file");
+        }
+        map_file(bytes);
+        header() = Header{MAGIC, sizeof(Key), sizeof(Value), new_bucket_count, old_size};
+        for (size_t index = 0; index < old_bucket_count; ++index) {
+            if (old_slots[index].distance_plus_one != 0) {
+                place(old_slots[index].key, old_slots[index].value);
+            }
+        }
+        if (::msync(region_, region_size_, MS_SYNC) != 0 || ::fsync(fd_) != 0
+                || ::rename(grow_path.c_str(), path_.c_str()) != 0) {
+            throw std::runtime_error("failed to replace map file");
+        }
+    } catch (...) {
+        if (region_ != MAP_FAILED) {
+            ::munmap(region_, region_size_);
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            ::unlink(grow_path.c_str());
+        }
+        fd_ = old_fd;
+        region_ = old_region;
+        region_size_ = old_region_size;
+        throw;
+    }
+    ::munmap(old_region, old_region_size);
+    ::close(old_fd);
+    sync_directory();
+}
+
+// The rename is only durable once the directory entry itself reaches the disk.
+template<typename Key, typename Value, typename Hash>
+void MappedHashMap<Key, Value, Hash>::sync_directory() const {
+    size_t separator = path_.rfind('/');
+    std::string directory = separator == std::string::npos ? "." : path_.substr(0, std::max<size_t>(separator, 1));
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open directory of " + path_);
+    }
+    int result = ::fsync(fd);
+    ::close(fd);
+    if (result != 0) {
+        throw std::runtime_error("failed to sync directory of " + path_);
+    }
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "hashmap.h"
+
+enum class PartitionScheme {
+    Jump,
+    Rendezvous,
+    Ring,
+};
+
+inline uint32_t jump_consistent_hash(uint64_t key, uint32_t bucket_count) {
+    int64_t bucket = -1;
+    int64_t next = 0;
+    while (next < bucket_count) {
+        bucket = next;
+        key = key * 2862933555777941757ull + 1;
+        next = static_cast<int64_t>((bucket + 1) * (static_cast<double>(1ll << 31) / static_cast<double>((key >> 33) + 1)));
+    }
+    return static_cast<uint32_t>(bucket);
+}
+
+template<typename Key, typename Hash = std::hash<Key>>
+class Partitioner {
+private:
+    inline static const size_t DEFAULT_VIRTUAL_NODES = 64;
+    inline static const uint64_t HASH_SEED = 0x9e3779b97f4a7c15ull;
+
+public:
+    Partitioner(size_t partition_count, PartitionScheme scheme = PartitionScheme::Jump, Hash hash = Hash{},
+                size_t virtual_nodes = DEFAULT_VIRTUAL_NODES);
+
+    size_t partition_of(const Key& key) const;
+    size_t partition_count() const;
+    PartitionScheme scheme() const;
+    const Hash& hash_function() const;
+
+private:
+    uint64_t key_hash(const Key& key) const;
+
+private:
+    Hash hasher_;
+    size_t partition_count_;
+    PartitionScheme scheme_;
+    std::vector<std::pair<uint64_t, size_t>> ring_;
+
+};
+
+template<typename Key, typename Hash>
+Partitioner<Key, Hash>::Partitioner(size_t partition_count, PartitionScheme scheme, Hash hash, size_t virtual_nodes)
+    : hasher_(std::move(hash))
+    , partition_count_(partition_count)
+    , scheme_(scheme)
+{
+    if (partition_count_ == 0) {
+        throw std::invalid_argument("partition count must be positive");
+    }
+    if (scheme_ == PartitionScheme::Ring) {
+        for (size_t partition = 0; partition < partition_count_; ++partition) {
+            for (size_t node = 0; node < std::max<size_t>(1, virtual_nodes); ++node) {
+                ring_.emplace_back(hash_mix((static_cast<uint64_t>(partition) << 32) ^ node), partition);
+            }
+        }
+        std::sort(ring_.begin(), ring_.end());
+    }
+}
+
+template<typename Key, typename Hash>
+size_t Partitioner<Key, Hash>::partition_of(const Key& key) const {
+    uint64_t hash = key_hash(key);
+    switch (scheme_) {
+    case PartitionScheme::Jump:
+        return jump_consistent_hash(hash, static_cast<uint32_t>(partition_count_));
+    case PartitionScheme::Rendezvous: {
+        size_t best = 0;
+        uint64_t best_weight = 0;
+        for (size_t partition = 0; partition < partition_count_; ++partition) {
+            uint64_t weight = hash_mix(hash ^ hash_mix(partition + 1));
+            if (partition == 0 || weight > best_weight) {
+                best = partition;
+                best_weight = weight;
+            }
+        }
+        return best;
+    }
+    case PartitionScheme::Ring: {
+        auto it = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(hash, size_t{0}));
+        return it == ring_.end() ? ring_.front().second : it->second;
+    }
+    }
+    return 0;
+}
+
+template<typename Key, typename Hash>
+size_t Partitioner<Key, Hash>::partition_count() const {
+    return partition_count_;
+}
+
+template<typename Key, typename Hash>
+PartitionScheme Partitioner<Key, Hash>::scheme() const {
+    return scheme_;
+}
+
+template<typename Key, typename Hash>
+const Hash& Partitioner<Key, Hash>::hash_function() const {
+    return hasher_;
+}
+
+template<typename Key, typename Hash>
+uint64_t Partitioner<Key, Hash>::key_hash(const Key& key) const {
+    // Salted so partition choice does not correlate with HashMap's bucket_index of the same key.
+    return hash_mix(static_cast<uint64_t>(hasher_(key)) ^ HASH_SEED);
+}
+
+template<typename Key, typename Value, typename Hash>
+std::vector<std::vector<typename HashMap<Key, Value, Hash>::NodeType>>
+        reshard(HashMap<Key, Value, Hash>& local, size_t self, const Partitioner<Key, Hash>& target) {
+    std::vector<std::vector<typename HashMap<Key, Value, Hash>::NodeType>> outgoing(target.partition_count());
+    auto moving = local.extract_if([&](const auto& node) {
+        return target.partition_of(node.first) != self;
+    });
+    for (auto& node : moving) {
+        outgoing[target.partition_of(node.first)].push_back(std::move(node));
+    }
+    return outgoing;
+}
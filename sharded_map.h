@@ -0,0 +1,366 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "hashmap.h"
+
+template<typename Task>
+class MpscQueue {
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        Task task;
+    };
+
+public:
+    MpscQueue();
+    MpscQueue(const MpscQueue<Task>& another) = delete;
+    MpscQueue<Task>& operator=(const MpscQueue<Task>& another) = delete;
+    ~MpscQueue();
+
+    void push(Task task);
+    bool pop(Task& task);
+    bool empty() const;
+
+private:
+    std::atomic<Node*> head_;
+    Node* tail_;
+
+};
+
+template<typename Task>
+MpscQueue<Task>::MpscQueue()
+    : head_(new Node)
+    , tail_(head_.load())
+{}
+
+template<typename Task>
+MpscQueue<Task>::~MpscQueue() {
+    Task task;
+    while (pop(task)) {}
+    delete tail_;
+}
+
+template<typename Task>
+void MpscQueue<Task>::push(Task task) {
+    Node* node = new Node;
+    node->task = std::move(task);
+    Node* previous = head_.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+}
+
+template<typename Task>
+bool MpscQueue<Task>::pop(Task& task) {
+    Node* next = tail_->next.load(std::memory_order_acquire);
+    if (next == nullptr) {
+        return false;
+    }
+    task = std::move(next->task);
+    delete tail_;
+    tail_ = next;
+    return true;
+}
+
+template<typename Task>
+bool MpscQueue<Task>::empty() const {
+    return tail_->next.load(std::memory_order_acquire) == nullptr;
+}
+
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class ShardedMap {
+private:
+    inline static const size_t SPIN_ROUNDS = 256;
+
+public:
+    using NodeType = std::pair<const Key, Value>;
+    using Map = HashMap<Key, Value, Hash>;
+    using Task = std::function<void(Map&)>;
+
+private:
+    struct Shard {
+        Map map;
+        MpscQueue<Task> queue;
+        std::atomic<bool> sleeping{false};
+        std::mutex mutex;
+        bool signalled = false;
+        std::condition_variable wake;
+        std::thread worker;
+
+        explicit Shard(const Hash& hash) : map(hash) {}
+    };
+
+    struct Completion {
+        std::promise<void> promise;
+        std::atomic<size_t> remaining;
+        std::mutex mutex;
+        std::exception_ptr error;
+
+        explicit Completion(size_t remaining) : remaining(remaining) {}
+
+        void finish(std::exception_ptr failure) {
+            if (failure) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) {
+                    error = failure;
+                }
+            }
+            if (--remaining == 0) {
+                if (error) {
+                    promise.set_exception(error);
+                } else {
+                    promise.set_value();
+                }
+            }
+        }
+    };
+
+public:
+    explicit ShardedMap(size_t shard_count = std::thread::hardware_concurrency(), Hash hash = Hash{});
+    ShardedMap(const ShardedMap<Key, Value, Hash>& another) = delete;
+    ShardedMap<Key, Value, Hash>& operator=(const ShardedMap<Key, Value, Hash>& another) = delete;
+    ~ShardedMap();
+
+    size_t shard_count() const;
+    size_t shard_of(const Key& key) const;
+
+    template<typename Function>
+    auto submit(const Key& key, Function function) -> std::future<decltype(function(std::declval<Map&>()))>;
+
+    std::future<void> insert(const NodeType& x);
+    std::future<void> erase(const Key& key);
+    std::future<std::optional<Value>> find(const Key& key);
+
+    std::future<void> insert_batch(const std::vector<NodeType>& nodes);
+
+    template<typename Function>
+    std::future<void> for_each_shard(Function function);
+
+    // Waits on every shard, so it throws std::logic_error when called from inside a shard task.
+    size_t size();
+
+private:
+    bool on_worker_thread() const;
+    void post(size_t shard, Task task);
+    void run(size_t shard);
+
+private:
+    Hash hasher_;
+    std::atomic<bool> stopping_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+};
+
+template<typename Key, typename Value, typename Hash>
+ShardedMap<Key, Value, Hash>::ShardedMap(size_t shard_count, Hash hash)
+    : hasher_(std::move(hash))
+    , stopping_(false)
+{
+    shard_count = std::max<size_t>(1, shard_count);
+    for (size_t index = 0; index < shard_count; ++index) {
+        shards_.push_back(std::make_unique<Shard>(hasher_));
+    }
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t index = 0; index < shard_count; ++index) {
+        shards_[index]->worker = std::thread([this, index] { run(index); });
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(index % cores, &cpus);
+        pthread_setaffinity_np(shards_[index]->worker.native_handle(), sizeof(cpus), &cpus);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+ShardedMap<Key, Value, Hash>::~ShardedMap() {
+    stopping_ = true;
+    for (auto& shard : shards_) {
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+        }
+        shard->wake.notify_all();
+    }
+    for (auto& shard : shards_) {
+        shard->worker.join();
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t ShardedMap<Key, Value, Hash>::shard_count() const {
+    return shards_.size();
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t ShardedMap<Key, Value, Hash>::shard_of(const Key& key) const {
+    return hash_mix(static_cast<uint64_t>(hasher_(key))) % shards_.size();
+}
+
+template<typename Key, typename Value, typename Hash>
+template<typename Function>
+auto ShardedMap<Key, Value, Hash>::submit(const Key& key, Function function)
+        -> std::future<decltype(function(std::declval<Map&>()))> {
+    using Result = decltype(function(std::declval<Map&>()));
+    auto promise = std::make_shared<std::promise<Result>>();
+    auto future = promise->get_future();
+    post(shard_of(key), [promise, function = std::move(function)](Map& map) mutable {
+        try {
+            if constexpr (std::is_void_v<Result>) {
+                function(map);
+                promise->set_value();
+            } else {
+                promise->set_value(function(map));
+            }
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    });
+    return future;
+}
+
+template<typename Key, typename Value, typename Hash>
+std::future<void> ShardedMap<Key, Value, Hash>::insert(const NodeType& x) {
+    return submit(x.first, [x](Map& map) { map.insert(x); });
+}
+
+template<typename Key, typename Value, typename Hash>
+std::future<void> ShardedMap<Key, Value, Hash>::erase(const Key& key) {
+    return submit(key, [key](Map& map) { map.erase(key); });
+}
+
+template<typename Key, typename Value, typename Hash>
+std::future<std::optional<Value>> ShardedMap<Key, Value, Hash>::find(const Key& key) {
+    return submit(key, [key](Map& map) -> std::optional<Value> {
+        const Map& shard = map;
+        auto it = shard.find(key);
+        if (it == shard.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    });
+}
+
+template<typename Key, typename Value, typename Hash>
+std::future<void> ShardedMap<Key, Value, Hash>::insert_batch(const std::vector<NodeType>& nodes) {
+    std::vector<std::vector<NodeType>> per_shard(shards_.size());
+    for (const auto& node : nodes) {
+        per_shard[shard_of(node.first)].push_back(node);
+    }
+
+    size_t batch_count = std::count_if(per_shard.begin(), per_shard.end(), [](const auto& batch) {
+        return !batch.empty();
+    });
+    auto completion = std::make_shared<Completion>(batch_count);
+    auto future = completion->promise.get_future();
+    if (batch_count == 0) {
+        completion->promise.set_value();
+        return future;
+    }
+    for (size_t index = 0; index < shards_.size(); ++index) {
+        if (per_shard[index].empty()) {
+            continue;
+        }
+        post(index, [completion, batch = std::move(per_shard[index])](Map& map) {
+            std::exception_ptr failure;
+            try {
+                map.insert(batch.begin(), batch.end());
+            } catch (...) {
+                failure = std::current_exception();
+            }
+            completion->finish(failure);
+        });
+    }
+    return future;
+}
+
+template<typename Key, typename Value, typename Hash>
+template<typename Function>
+std::future<void> ShardedMap<Key, Value, Hash>::for_each_shard(Function function) {
+    auto completion = std::make_shared<Completion>(shards_.size());
+    auto shared_function = std::make_shared<Function>(std::move(function));
+    auto future = completion->promise.get_future();
+    for (size_t index = 0; index < shards_.size(); ++index) {
+        post(index, [completion, shared_function, index](Map& map) {
+            std::exception_ptr failure;
+            try {
+                (*shared_function)(index, map);
+            } catch (...) {
+                failure = std::current_exception();
+            }
+            completion->finish(failure);
+        });
+    }
+    return future;
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t ShardedMap<Key, Value, Hash>::size() {
+    if (on_worker_thread()) {
+        throw std::logic_error("ShardedMap::size() called from a shard task would deadlock");
+    }
+    std::atomic<size_t> total{0};
+    for_each_shard([&total](size_t, Map& map) { total += map.size(); }).get();
+    return total;
+}
+
+template<typename Key, typename Value, typename Hash>
+bool ShardedMap<Key, Value, Hash>::on_worker_thread() const {
+    std::thread::id current = std::this_thread::get_id();
+    return std::any_of(shards_.begin(), shards_.end(), [current](const auto& shard) {
+        return shard->worker.get_id() == current;
+    });
+}
+
+// The fences pair with run(): either the producer sees the worker going to sleep and signals it
+// under the mutex, or the worker sees the pushed task before it waits.
+template<typename Key, typename Value, typename Hash>
+void ShardedMap<Key, Value, Hash>::post(size_t shard, Task task) {
+    Shard& target = *shards_[shard];
+    target.queue.push(std::move(task));
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (target.sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(target.mutex);
+        target.signalled = true;
+        target.wake.notify_one();
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void ShardedMap<Key, Value, Hash>::run(size_t shard) {
+    Shard& self = *shards_[shard];
+    Task task;
+    size_t idle_rounds = 0;
+    for ( ; ; ) {
+        if (self.queue.pop(task)) {
+            task(self.map);
+            idle_rounds = 0;
+            continue;
+        }
+        if (stopping_) {
+            return;
+        }
+        if (++idle_rounds < SPIN_ROUNDS) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(self.mutex);
+        self.sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        self.wake.wait(lock, [&self, this] { return self.signalled || !self.queue.empty() || stopping_; });
+        self.signalled = false;
+        self.sleeping.store(false, std::memory_order_relaxed);
+    }
+}
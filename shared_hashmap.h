@@ -0,0 +1,543 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+template<typename Key>
+struct SharedKeyTraits {
+    static_assert(std::is_trivially_copyable_v<Key>, "shared keys must be trivially copyable or std::string");
+
+    using StoredKey = Key;
+
+    static size_t bytes_needed(const Key&) {
+        return 0;
+    }
+    static StoredKey store(char*, uint64_t&, const Key& key) {
+        return key;
+    }
+    static bool equals(const char*, uint64_t, const StoredKey& stored, const Key& key) {
+        return stored == key;
+    }
+    static size_t bytes_used(const StoredKey&) {
+        return 0;
+    }
+    static StoredKey relocate(const char*, char*, uint64_t&, const StoredKey& stored) {
+        return stored;
+    }
+};
+
+template<>
+struct SharedKeyTraits<std::string> {
+    struct StoredKey {
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    static size_t bytes_needed(const std::string& key) {
+        return key.size();
+    }
+    static StoredKey store(char* arena, uint64_t& used, const std::string& key) {
+        StoredKey stored{used, key.size()};
+        std::memcpy(arena + used, key.data(), key.size());
+        used += key.size();
+        return stored;
+    }
+    static bool equals(const char* arena, uint64_t arena_capacity, const StoredKey& stored, const std::string& key) {
+        if (stored.length != key.size() || stored.offset > arena_capacity
+                || stored.length > arena_capacity - stored.offset) {
+            return false;
+        }
+        return std::memcmp(arena + stored.offset, key.data(), key.size()) == 0;
+    }
+    static size_t bytes_used(const StoredKey& stored) {
+        return stored.length;
+    }
+    static StoredKey relocate(const char* from, char* to, uint64_t& used, const StoredKey& stored) {
+        StoredKey moved{used, stored.length};
+        std::memcpy(to + used, from + stored.offset, stored.length);
+        used += stored.length;
+        return moved;
+    }
+};
+
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class SharedHashMap {
+private:
+    inline static const uint64_t MAGIC = 0x31504d4853524853ull;
+    inline static const float MAX_LOAD_FACTOR = 0.6;
+    inline static const size_t READ_RETRY_LIMIT = 1 << 20;
+    inline static const size_t ABANDONED_CHECK_INTERVAL = 1 << 10;
+
+    using Traits = SharedKeyTraits<Key>;
+    using StoredKey = typename Traits::StoredKey;
+
+public:
+    using NodeType = std::pair<const Key, Value>;
+
+private:
+    struct Header {
+        uint64_t magic;
+        uint64_t key_size;
+        uint64_t value_size;
+        uint64_t bucket_count;
+        uint64_t arena_capacity;
+        uint64_t arena_used;
+        uint64_t arena_live;
+        std::atomic<uint64_t> size;
+        std::atomic<uint64_t> sequence;
+        pthread_mutex_t writer_lock;
+    };
+
+    struct Slot {
+        uint64_t distance_plus_one;
+        StoredKey key;
+        Value value;
+    };
+
+    class WriteGuard {
+    public:
+        explicit WriteGuard(const SharedHashMap<Key, Value, Hash>& map);
+        ~WriteGuard();
+    private:
+        Header& header_;
+    };
+
+public:
+    static SharedHashMap<Key, Value, Hash> create(const std::string& name, size_t max_entries,
+                                                  size_t arena_bytes = 0, Hash hash = Hash{});
+    static SharedHashMap<Key, Value, Hash> attach(const std::string& name, Hash hash = Hash{});
+    static void unlink(const std::string& name);
+
+    SharedHashMap(SharedHashMap<Key, Value, Hash>&& another);
+    SharedHashMap(const SharedHashMap<Key, Value, Hash>& another) = delete;
+    SharedHashMap<Key, Value, Hash>& operator=(const SharedHashMap<Key, Value, Hash>& another) = delete;
+    ~SharedHashMap();
+
+    size_t size() const;
+    bool empty() const;
+    size_t bucket_count() const;
+
+    const Hash& hash_function() const;
+
+    bool insert(const NodeType& x);
+    void insert_or_assign(const Key& key, const Value& value);
+    void erase(const Key& key);
+    void clear();
+
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+
+private:
+    SharedHashMap(Hash hash, int fd, void* region, size_t region_size);
+
+    static size_t next_prime(size_t value);
+
+    Header& header() const;
+    Slot* slots() const;
+    char* arena() const;
+    void lock_writer() const;
+    void recover_abandoned_writer() const;
+    void repair_abandoned() const;
+    size_t find_index(const Key& key) const;
+    void insert_new(const Key& key, const Value& value);
+    void place(size_t hash, Slot current);
+    void erase_at(size_t hash);
+    StoredKey store_key(const Key& key);
+    void compact_arena();
+
+private:
+    Hash hasher_;
+    int fd_;
+    void* region_;
+    size_t region_size_;
+
+};
+
+template<typename Key, typename Value, typename Hash>
+SharedHashMap<Key, Value, Hash>::WriteGuard::WriteGuard(const SharedHashMap<Key, Value, Hash>& map)
+    : header_(map.header())
+{
+    map.lock_writer();
+    header_.sequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+template<typename Key, typename Value, typename Hash>
+SharedHashMap<Key, Value, Hash>::WriteGuard::~WriteGuard() {
+    header_.sequence.fetch_add(1, std::memory_order_release);
+    pthread_mutex_unlock(&header_.writer_lock);
+}
+
+template<typename Key, typename Value, typename Hash>
+SharedHashMap<Key, Value, Hash> SharedHashMap<Key, Value, Hash>::create(const std::string& name, size_t max_entries,
+                                                                        size_t arena_bytes, Hash hash) {
+    static_assert(std::is_trivially_copyable_v<Value>, "shared values must be trivially copyable");
+
+    size_t bucket_count = next_prime(static_cast<size_t>(max_entries / MAX_LOAD_FACTOR) + 1);
+    size_t region_size = sizeof(Header) + bucket_count * sizeof(Slot) + arena_bytes;
+
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("failed to create shared memory " + name);
+    }
+    if (::ftruncate(fd, region_size) != 0) {
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        throw std::runtime_error("failed to size shared memory " + name);
+    }
+    void* region = ::mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (region == MAP_FAILED) {
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        throw std::runtime_error("failed to map shared memory " + name);
+    }
+
+    Header* header = new (region) Header;
+    header->key_size = sizeof(StoredKey);
+    header->value_size = sizeof(Value);
+    header->bucket_count = bucket_count;
+    header->arena_capacity = arena_bytes;
+    header->arena_used = 0;
+    header->arena_live = 0;
+    header->size = 0;
+    header->sequence.store(0, std::memory_order_relaxed);
+
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&header->writer_lock, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = MAGIC;
+    return SharedHashMap<Key, Value, Hash>(std::move(hash), fd, region, region_size);
+}
+
+template<typename Key, typename Value, typename Hash>
+SharedHashMap<Key, Value, Hash> SharedHashMap<Key, Value, Hash>::attach(const std::string& name, Hash hash) {
+    int fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open shared memory " + name);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Header)) {
+        ::close(fd);
+        throw std::runtime_error("bad shared memory segment " + name);
+    }
+    size_t region_size = static_cast<size_t>(info.st_size);
+    void* region = ::mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (region == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("failed to map shared memory " + name);
+    }
+    SharedHashMap<Key, Value, Hash> map(std::move(hash), fd, region, region_size);
+    const Header& header = map.header();
+    if (header.magic != MAGIC || header.key_size != sizeof(StoredKey) || header.value_size != sizeof(Value)
+            || sizeof(Header) + header.bucket_count * sizeof(Slot) + header.arena_capacity > region_size) {
+        throw std::runtime_error("incompatible shared memory segment " + name);
+    }
+    return map;
+}
+
+template<typename Key, typename Value, typename Hash>
+void SharedHashMap<Key, Value, Hash>::unlink(const std::string& name) {
+    ::shm_unlink(name.c_str());
+}
+
+template<typename Key, typename Value, typename Hash>
+SharedHashMap<Key, Value, Hash>::SharedHashMap(Hash hash, int fd, void* region, size_t region_size)
+    : hasher_(std::move(hash))
+    , fd_(fd)
+    , region_(region)
+    , region_size_(region_size)
+{}
+
+template<typename Key, typename Value, typename Hash>
+SharedHashMap<Key, Value, Hash>::SharedHashMap(SharedHashMap<Key, Value, Hash>&& another)
+    : hasher_(std::move(another.hasher_))
+    , fd_(std::exchange(another.fd_, -1))
+    , region_(std::exchange(another.region_, MAP_FAILED))
+    , region_size_(std::exchange(another.region_size_, 0))
+{}
+
+template<typename Key, typename Value, typename Hash>
+SharedHashMap<Key, Value, Hash>::~SharedHashMap() {
+    if (region_ != MAP_FAILED) {
+        ::munmap(region_, region_size_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t SharedHashMap<Key, Value, Hash>::size() const {
+    return header().size.load(std::memory_order_relaxed);
+}
+
+template<typename Key, typename Value, typename Hash>
+bool SharedHashMap<Key, Value, Hash>::empty() const {
+    return size() == 0;
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t SharedHashMap<Key, Value, Hash>::bucket_count() const {
+    return header().bucket_count;
+}
+
+template<typename Key, typename Value, typename Hash>
+const Hash& SharedHashMap<Key, Value, Hash>::hash_function() const {
+    return hasher_;
+}
+
+template<typename Key, typename Value, typename Hash>
+bool SharedHashMap<Key, Value, Hash>::insert(const NodeType& x) {
+    WriteGuard guard(*this);
+    if (find_index(x.first) != bucket_count()) {
+        return false;
+    }
+    insert_new(x.first, x.second);
+    return true;
+}
+
+template<typename Key, typename Value, typename Hash>
+void SharedHashMap<Key, Value, Hash>::insert_or_assign(const Key& key, const Value& value) {
+    WriteGuard guard(*this);
+    size_t index = find_index(key);
+    if (index != bucket_count()) {
+        slots()[index].value = value;
+        return;
+    }
+    insert_new(key, value);
+}
+
+template<typename Key, typename Value, typename Hash>
+void SharedHashMap<Key, Value, Hash>::erase(const Key& key) {
+    WriteGuard guard(*this);
+    size_t index = find_index(key);
+    if (index != bucket_count()) {
+        erase_at(index);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void SharedHashMap<Key, Value, Hash>::clear() {
+    WriteGuard guard(*this);
+    Slot* table = slots();
+    for (size_t index = 0; index < bucket_count(); ++index) {
+        table[index].distance_plus_one = 0;
+    }
+    header().size = 0;
+    header().arena_used = 0;
+    header().arena_live = 0;
+}
+
+template<typename Key, typename Value, typename Hash>
+bool SharedHashMap<Key, Value, Hash>::find(const Key& key, Value& value) const {
+    const Header& shared = header();
+    for (size_t retries = 0; ; ++retries) {
+        if (retries == READ_RETRY_LIMIT) {
+            throw std::runtime_error("shared map writer did not finish");
+        }
+        uint64_t before = shared.sequence.load(std::memory_order_acquire);
+        if (before % 2 == 1) {
+            if (retries % ABANDONED_CHECK_INTERVAL == ABANDONED_CHECK_INTERVAL - 1) {
+                recover_abandoned_writer();
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        size_t index = find_index(key);
+        bool found = index != bucket_count();
+        if (found) {
+            std::memcpy(static_cast<void*>(&value), &slots()[index].value, sizeof(Value));
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (shared.sequence.load(std::memory_order_relaxed) == before) {
+            return found;
+        }
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+bool SharedHashMap<Key, Value, Hash>::contains(const Key& key) const {
+    Value value;
+    return find(key, value);
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t SharedHashMap<Key, Value, Hash>::next_prime(size_t value) {
+    for ( ; ; ++value) {
+        bool prime = true;
+        for (size_t div = 2; div * div <= value; ++div) {
+            if (value % div == 0) {
+                prime = false;
+                break;
+            }
+        }
+        if (prime) return value;
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+typename SharedHashMap<Key, Value, Hash>::Header& SharedHashMap<Key, Value, Hash>::header() const {
+    return *static_cast<Header*>(region_);
+}
+
+template<typename Key, typename Value, typename Hash>
+typename SharedHashMap<Key, Value, Hash>::Slot* SharedHashMap<Key, Value, Hash>::slots() const {
+    return reinterpret_cast<Slot*>(static_cast<char*>(region_) + sizeof(Header));
+}
+
+template<typename Key, typename Value, typename Hash>
+char* SharedHashMap<Key, Value, Hash>::arena() const {
+    return reinterpret_cast<char*>(slots() + header().bucket_count);
+}
+
+template<typename Key, typename Value, typename Hash>
+void SharedHashMap<Key, Value, Hash>::lock_writer() const {
+    int result = pthread_mutex_lock(&header().writer_lock);
+    if (result == EOWNERDEAD) {
+        repair_abandoned();
+    } else if (result != 0) {
+        throw std::runtime_error("failed to lock shared map");
+    }
+}
+
+// Lets readers unblock themselves when the writer died mid-update and no other writer has come along.
+template<typename Key, typename Value, typename Hash>
+void SharedHashMap<Key, Value, Hash>::recover_abandoned_writer() const {
+    int result = pthread_mutex_trylock(&header().writer_lock);
+    if (result == EOWNERDEAD) {
+        repair_abandoned();
+    }
+    if (result == EOWNERDEAD || result == 0) {
+        pthread_mutex_unlock(&header().writer_lock);
+    }
+}
+
+// Called holding the lock a dead writer abandoned: recounts the totals it may have left half-updated
+// and closes its odd sequence so readers stop retrying.
+template<typename Key, typename Value, typename Hash>
+void SharedHashMap<Key, Value, Hash>::repair_abandoned() const {
+    Header& shared = header();
+    const Slot* table = slots();
+    uint64_t size = 0;
+    uint64_t live = 0;
+    for (size_t index = 0; index < bucket_count(); ++index) {
+        if (table[index].distance_plus_one != 0) {
+            ++size;
+            live += Traits::bytes_used(table[index].key);
+        }
+    }
+    shared.size = size;
+    shared.arena_live = live;
+    if (shared.sequence.load(std::memory_order_relaxed) % 2 == 1) {
+        shared.sequence.fetch_add(1, std::memory_order_release);
+    }
+    pthread_mutex_consistent(&shared.writer_lock);
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t SharedHashMap<Key, Value, Hash>::find_index(const Key& key) const {
+    size_t buckets = bucket_count();
+    const Slot* table = slots();
+    const char* strings = arena();
+    uint64_t arena_capacity = header().arena_capacity;
+    size_t hash = hasher_(key) % buckets;
+    for (uint64_t distance = 1; distance <= buckets; ++distance) {
+        if (table[hash].distance_plus_one < distance) {
+            return buckets;
+        }
+        if (Traits::equals(strings, arena_capacity, table[hash].key, key)) {
+            return hash;
+        }
+        hash = (hash + 1) % buckets;
+    }
+    return buckets;
+}
+
+template<typename Key, typename Value, typename Hash>
+void SharedHashMap<Key, Value, Hash>::insert_new(const Key& key, const Value& value) {
+    if (static_cast<double>(header().size + 1) / bucket_count() >= MAX_LOAD_FACTOR) {
+        throw std::length_error("shared map is full");
+    }
+    place(hasher_(key) % bucket_count(), Slot{1, store_key(key), value});
+    ++header().size;
+}
+
+template<typename Key, typename Value, typename Hash>
+void SharedHashMap<Key, Value, Hash>::place(size_t hash, Slot current) {
+    size_t buckets = bucket_count();
+    Slot* table = slots();
+    while (table[hash].distance_plus_one != 0) {
+        if (table[hash].distance_plus_one < current.distance_plus_one) {
+            std::swap(current, table[hash]);
+        }
+        ++current.distance_plus_one;
+        hash = (hash + 1) % buckets;
+    }
+    table[hash] = current;
+}
+
+template<typename Key, typename Value, typename Hash>
+void SharedHashMap<Key, Value, Hash>::erase_at(size_t hash) {
+    size_t buckets = bucket_count();
+    Slot* table = slots();
+    header().arena_live -= Traits::bytes_used(table[hash].key);
+    table[hash].distance_plus_one = 0;
+    size_t next_hash = (hash + 1) % buckets;
+    while (table[next_hash].distance_plus_one > 1) {
+        table[hash] = table[next_hash];
+        --table[hash].distance_plus_one;
+        table[next_hash].distance_plus_one = 0;
+        hash = next_hash;
+        next_hash = (hash + 1) % buckets;
+    }
+    --header().size;
+}
+
+template<typename Key, typename Value, typename Hash>
+typename SharedHashMap<Key, Value, Hash>::StoredKey SharedHashMap<Key, Value, Hash>::store_key(const Key& key) {
+    size_t needed = Traits::bytes_needed(key);
+    Header& shared = header();
+    if (shared.arena_used + needed > shared.arena_capacity) {
+        compact_arena();
+        if (shared.arena_used + needed > shared.arena_capacity) {
+            throw std::length_error("shared map arena is full");
+        }
+    }
+    shared.arena_live += needed;
+    return Traits::store(arena(), shared.arena_used, key);
+}
+
+template<typename Key, typename Value, typename Hash>
+void SharedHashMap<Key, Value, Hash>::compact_arena() {
+    Header& shared = header();
+    std::vector<char> live(arena(), arena() + shared.arena_used);
+    uint64_t used = 0;
+    Slot* table = slots();
+    for (size_t index = 0; index < bucket_count(); ++index) {
+        if (table[index].distance_plus_one != 0) {
+            table[index].key = Traits::relocate(live.data(), arena(), used, table[index].key);
+        }
+    }
+    shared.arena_used = used;
+    shared.arena_live = used;
+}
@@ -0,0 +1,501 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "hashmap.h"
+
+struct SnapshotHeader {
+    uint64_t magic;
+    uint64_t key_size;
+    uint64_t value_size;
+    uint64_t count;
+};
+
+inline const uint64_t SNAPSHOT_MAGIC = 0x3150414e53504d48ull;
+inline const uint64_t COMPRESSED_SNAPSHOT_MAGIC = 0x3150414e535a4d48ull;
+inline const size_t COMPRESSED_BLOCK_RECORDS = 128;
+
+template<typename Key, typename Value, typename Hash>
+void write_snapshot(std::ostream& out, const HashMap<Key, Value, Hash>& map) {
+    static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Value>,
+                  "snapshots require trivially copyable keys and values");
+
+    SnapshotHeader header{SNAPSHOT_MAGIC, sizeof(Key), sizeof(Value), map.size()};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& node : map) {
+        out.write(reinterpret_cast<const char*>(&node.first), sizeof(Key));
+        out.write(reinterpret_cast<const char*>(&node.second), sizeof(Value));
+    }
+    if (!out) {
+        throw std::runtime_error("failed to write snapshot");
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void read_snapshot(std::istream& in, HashMap<Key, Value, Hash>& map) {
+    static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Value>,
+                  "snapshots require trivially copyable keys and values");
+
+    SnapshotHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != SNAPSHOT_MAGIC) {
+        throw std::runtime_error("bad snapshot header");
+    }
+    if (header.key_size != sizeof(Key) || header.value_size != sizeof(Value)) {
+        throw std::runtime_error("snapshot type mismatch");
+    }
+    map.reserve(map.size() + header.count);
+    for (uint64_t i = 0; i < header.count; ++i) {
+        Key key;
+        Value value;
+        in.read(reinterpret_cast<char*>(&key), sizeof(Key));
+        in.read(reinterpret_cast<char*>(&value), sizeof(Value));
+        if (!in) {
+            throw std::runtime_error("truncated snapshot");
+        }
+        map.insert({key, value});
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void save_snapshot(const std::string& path, const HashMap<Key, Value, Hash>& map) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("failed to open " + path);
+    }
+    write_snapshot(out, map);
+}
+
+template<typename Key, typename Value, typename Hash>
+class SnapshotLoader {
+private:
+    inline static const size_t DEFAULT_BLOCK_BYTES = 4 << 20;
+    inline static const size_t DEFAULT_READER_COUNT = 2;
+    inline static const size_t RECORD_SIZE = sizeof(Key) + sizeof(Value);
+
+    struct Block {
+        std::vector<char> data;
+        size_t records = 0;
+    };
+
+    struct FileGuard {
+        int fd;
+
+        explicit FileGuard(int fd) : fd(fd) {}
+        FileGuard(const FileGuard& another) = delete;
+        FileGuard& operator=(const FileGuard& another) = delete;
+        ~FileGuard() {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+    };
+
+public:
+    SnapshotLoader(HashMap<Key, Value, Hash>& map, size_t reader_count = DEFAULT_READER_COUNT,
+                   size_t block_bytes = DEFAULT_BLOCK_BYTES);
+
+    void load(const std::string& path);
+
+private:
+    void read_blocks(int fd);
+    void insert_block(const Block& block);
+
+private:
+    HashMap<Key, Value, Hash>& map_;
+    size_t reader_count_;
+    size_t records_per_block_;
+
+    uint64_t record_count_;
+    size_t block_count_;
+    std::atomic<size_t> next_block_;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<Block> free_blocks_;
+    std::deque<Block> ready_blocks_;
+    size_t finished_readers_;
+    bool cancelled_;
+    std::exception_ptr error_;
+
+};
+
+template<typename Key, typename Value, typename Hash>
+SnapshotLoader<Key, Value, Hash>::SnapshotLoader(HashMap<Key, Value, Hash>& map, size_t reader_count,
+                                                 size_t block_bytes)
+    : map_(map)
+    , reader_count_(std::max<size_t>(1, reader_count))
+    , records_per_block_(std::max<size_t>(1, block_bytes / RECORD_SIZE))
+    , record_count_(0)
+    , block_count_(0)
+    , next_block_(0)
+    , finished_readers_(0)
+    , cancelled_(false)
+{
+    static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Value>,
+                  "snapshots require trivially copyable keys and values");
+}
+
+template<typename Key, typename Value, typename Hash>
+void SnapshotLoader<Key, Value, Hash>::load(const std::string& path) {
+    FileGuard file(::open(path.c_str(), O_RDONLY));
+    int fd = file.fd;
+    if (fd < 0) {
+        throw std::runtime_error("failed to open " + path);
+    }
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    SnapshotHeader header;
+    if (::pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))
+            || header.magic != SNAPSHOT_MAGIC) {
+        throw std::runtime_error("bad snapshot header");
+    }
+    if (header.key_size != sizeof(Key) || header.value_size != sizeof(Value)) {
+        throw std::runtime_error("snapshot type mismatch");
+    }
+
+    record_count_ = header.count;
+    block_count_ = (record_count_ + records_per_block_ - 1) / records_per_block_;
+    next_block_ = 0;
+    finished_readers_ = 0;
+    cancelled_ = false;
+    error_ = nullptr;
+    free_blocks_.clear();
+    ready_blocks_.clear();
+    for (size_t i = 0; i < reader_count_ * 2; ++i) {
+        free_blocks_.emplace_back();
+        free_blocks_.back().data.resize(records_per_block_ * RECORD_SIZE);
+    }
+    map_.reserve(map_.size() + record_count_);
+
+    std::vector<std::thread> readers;
+    try {
+        for (size_t i = 0; i < reader_count_; ++i) {
+            readers.emplace_back([this, fd] { read_blocks(fd); });
+        }
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cancelled_ = true;
+        }
+        changed_.notify_all();
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        throw;
+    }
+
+    std::exception_ptr insert_error;
+    for ( ; ; ) {
+        Block block;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [this] {
+                return !ready_blocks_.empty() || finished_readers_ == reader_count_;
+            });
+            if (ready_blocks_.empty()) {
+                break;
+            }
+            block = std::move(ready_blocks_.front());
+            ready_blocks_.pop_front();
+        }
+        if (!insert_error) {
+            try {
+                insert_block(block);
+            } catch (...) {
+                insert_error = std::current_exception();
+                std::lock_guard<std::mutex> lock(mutex_);
+                cancelled_ = true;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_blocks_.push_back(std::move(block));
+        }
+        changed_.notify_all();
+    }
+
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    if (insert_error) {
+        std::rethrow_exception(insert_error);
+    }
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void SnapshotLoader<Key, Value, Hash>::read_blocks(int fd) {
+    try {
+        for (size_t index = next_block_++; index < block_count_; index = next_block_++) {
+            Block block;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                changed_.wait(lock, [this] { return !free_blocks_.empty() || cancelled_; });
+                if (cancelled_) {
+                    break;
+                }
+                block = std::move(free_blocks_.front());
+                free_blocks_.pop_front();
+            }
+
+            uint64_t first_record = index * records_per_block_;
+            block.records = std::min<uint64_t>(records_per_block_, record_count_ - first_record);
+            size_t bytes = block.records * RECORD_SIZE;
+            off_t offset = sizeof(SnapshotHeader) + first_record * RECORD_SIZE;
+            size_t done = 0;
+            while (done < bytes) {
+                ssize_t read = ::pread(fd, block.data.data() + done, bytes - done, offset + done);
+                if (read <= 0) {
+                    throw std::runtime_error("truncated snapshot");
+                }
+                done += static_cast<size_t>(read);
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            ready_blocks_.push_back(std::move(block));
+            changed_.notify_all();
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_) {
+            error_ = std::current_exception();
+        }
+        cancelled_ = true;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++finished_readers_;
+    changed_.notify_all();
+}
+
+template<typename Key, typename Value, typename Hash>
+void SnapshotLoader<Key, Value, Hash>::insert_block(const Block& block) {
+    const char* record = block.data.data();
+    for (size_t i = 0; i < block.records; ++i, record += RECORD_SIZE) {
+        Key key;
+        Value value;
+        std::memcpy(&key, record, sizeof(Key));
+        std::memcpy(&value, record + sizeof(Key), sizeof(Value));
+        map_.insert({key, value});
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void load_snapshot(const std::string& path, HashMap<Key, Value, Hash>& map) {
+    SnapshotLoader<Key, Value, Hash> loader(map);
+    loader.load(path);
+}
+
+template<typename T>
+uint64_t to_ordered_bits(T value) {
+    uint64_t bits = static_cast<uint64_t>(static_cast<std::make_unsigned_t<T>>(value));
+    if constexpr (std::is_signed_v<T>) {
+        bits ^= uint64_t{1} << (sizeof(T) * 8 - 1);
+    }
+    return bits;
+}
+
+template<typename T>
+T from_ordered_bits(uint64_t bits) {
+    if constexpr (std::is_signed_v<T>) {
+        bits ^= uint64_t{1} << (sizeof(T) * 8 - 1);
+    }
+    return static_cast<T>(static_cast<std::make_unsigned_t<T>>(bits));
+}
+
+template<typename T>
+uint64_t to_zigzag_bits(T value) {
+    if constexpr (std::is_signed_v<T>) {
+        int64_t wide = static_cast<int64_t>(value);
+        return (static_cast<uint64_t>(wide) << 1) ^ static_cast<uint64_t>(wide >> 63);
+    } else {
+        return static_cast<uint64_t>(value);
+    }
+}
+
+template<typename T>
+T from_zigzag_bits(uint64_t bits) {
+    if constexpr (std::is_signed_v<T>) {
+        return static_cast<T>(static_cast<int64_t>((bits >> 1) ^ (~(bits & 1) + 1)));
+    } else {
+        return static_cast<T>(bits);
+    }
+}
+
+inline void append_varint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+inline const uint8_t* decode_varint(const uint8_t* in, const uint8_t* end, uint64_t& value) {
+    if (end - in >= 8) {
+        uint64_t word;
+        std::memcpy(&word, in, sizeof(word));
+        uint64_t stops = ~word & 0x8080808080808080ull;
+        if (stops != 0) {
+            size_t length = __builtin_ctzll(stops) / 8 + 1;
+            uint64_t bits = word & (length == 8 ? ~uint64_t{0} : ((uint64_t{1} << (length * 8)) - 1));
+            value = 0;
+            for (size_t i = 0; i < length; ++i) {
+                value |= ((bits >> (i * 8)) & 0x7f) << (i * 7);
+            }
+            return in + length;
+        }
+    }
+    value = 0;
+    for (int shift = 0; in != end && shift < 64; shift += 7) {
+        uint8_t byte = *in++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return in;
+        }
+    }
+    throw std::runtime_error("corrupt varint");
+}
+
+inline void append_packed(std::vector<uint8_t>& out, const uint64_t* values, size_t count, unsigned width) {
+    size_t start = out.size();
+    out.resize(start + (count * width + 7) / 8 + 8, 0);
+    uint8_t* base = out.data() + start;
+    for (size_t i = 0; i < count; ++i) {
+        size_t bit = i * width;
+        uint64_t word;
+        std::memcpy(&word, base + bit / 8, sizeof(word));
+        word |= values[i] << (bit % 8);
+        std::memcpy(base + bit / 8, &word, sizeof(word));
+        if (bit % 8 + width > 64) {
+            base[bit / 8 + 8] |= static_cast<uint8_t>(values[i] >> (64 - bit % 8));
+        }
+    }
+    out.resize(start + (count * width + 7) / 8);
+}
+
+inline void unpack(const uint8_t* in, size_t count, unsigned width, uint64_t* values) {
+    uint64_t mask = width == 64 ? ~uint64_t{0} : (uint64_t{1} << width) - 1;
+    size_t bytes = (count * width + 7) / 8;
+    for (size_t i = 0; i < count; ++i) {
+        size_t bit = i * width;
+        uint8_t buffer[9] = {};
+        std::memcpy(buffer, in + bit / 8, std::min<size_t>(9, bytes - bit / 8));
+        uint64_t word;
+        std::memcpy(&word, buffer, sizeof(word));
+        uint64_t value = word >> (bit % 8);
+        if (bit % 8 + width > 64) {
+            value |= static_cast<uint64_t>(buffer[8]) << (64 - bit % 8);
+        }
+        values[i] = value & mask;
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void write_compressed_snapshot(std::ostream& out, const HashMap<Key, Value, Hash>& map) {
+    static_assert(std::is_integral_v<Key> && std::is_integral_v<Value>,
+                  "compressed snapshots require integral keys and values");
+
+    std::vector<std::pair<uint64_t, uint64_t>> records;
+    records.reserve(map.size());
+    for (const auto& node : map) {
+        records.emplace_back(to_ordered_bits(node.first), to_zigzag_bits(node.second));
+    }
+    std::sort(records.begin(), records.end());
+
+    SnapshotHeader header{COMPRESSED_SNAPSHOT_MAGIC, sizeof(Key), sizeof(Value), records.size()};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<uint8_t> block;
+    uint64_t values[COMPRESSED_BLOCK_RECORDS];
+    uint64_t previous_key = 0;
+    for (size_t first = 0; first < records.size(); first += COMPRESSED_BLOCK_RECORDS) {
+        size_t count = std::min(COMPRESSED_BLOCK_RECORDS, records.size() - first);
+        block.clear();
+
+        uint64_t all_bits = 0;
+        for (size_t i = 0; i < count; ++i) {
+            values[i] = records[first + i].second;
+            all_bits |= values[i];
+        }
+        unsigned width = all_bits == 0 ? 0 : 64 - __builtin_clzll(all_bits);
+        block.push_back(static_cast<uint8_t>(width));
+        append_packed(block, values, count, width);
+
+        for (size_t i = 0; i < count; ++i) {
+            append_varint(block, records[first + i].first - previous_key);
+            previous_key = records[first + i].first;
+        }
+
+        uint32_t block_size = static_cast<uint32_t>(block.size());
+        out.write(reinterpret_cast<const char*>(&block_size), sizeof(block_size));
+        out.write(reinterpret_cast<const char*>(block.data()), block.size());
+    }
+    if (!out) {
+        throw std::runtime_error("failed to write snapshot");
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void read_compressed_snapshot(std::istream& in, HashMap<Key, Value, Hash>& map) {
+    static_assert(std::is_integral_v<Key> && std::is_integral_v<Value>,
+                  "compressed snapshots require integral keys and values");
+
+    SnapshotHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != COMPRESSED_SNAPSHOT_MAGIC) {
+        throw std::runtime_error("bad snapshot header");
+    }
+    if (header.key_size != sizeof(Key) || header.value_size != sizeof(Value)) {
+        throw std::runtime_error("snapshot type mismatch");
+    }
+    map.reserve(map.size() + header.count);
+
+    std::vector<uint8_t> block;
+    uint64_t values[COMPRESSED_BLOCK_RECORDS];
+    uint64_t key = 0;
+    for (uint64_t first = 0; first < header.count; first += COMPRESSED_BLOCK_RECORDS) {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(COMPRESSED_BLOCK_RECORDS, header.count - first));
+        uint32_t block_size;
+        if (!in.read(reinterpret_cast<char*>(&block_size), sizeof(block_size)) || block_size == 0) {
+            throw std::runtime_error("truncated snapshot");
+        }
+        block.resize(block_size);
+        if (!in.read(reinterpret_cast<char*>(block.data()), block_size)) {
+            throw std::runtime_error("truncated snapshot");
+        }
+
+        const uint8_t* cursor = block.data();
+        const uint8_t* end = cursor + block.size();
+        unsigned width = *cursor++;
+        size_t packed_bytes = (count * width + 7) / 8;
+        if (width > 64 || static_cast<size_t>(end - cursor) < packed_bytes) {
+            throw std::runtime_error("corrupt snapshot block");
+        }
+        unpack(cursor, count, width, values);
+        cursor += packed_bytes;
+
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t delta;
+            cursor = decode_varint(cursor, end, delta);
+            key += delta;
+            map.insert({from_ordered_bits<Key>(key), from_zigzag_bits<Value>(values[i])});
+        }
+    }
+}
@@ -0,0 +1,208 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "hashmap.h"
+
+template<typename Key, typename Value, typename Combine = std::plus<Value>, typename Hash = std::hash<Key>>
+class SpillingAggregator {
+private:
+    inline static const size_t PARTITION_FANOUT = 16;
+    inline static const size_t MAX_SPILL_DEPTH = 8;
+
+public:
+    using NodeType = std::pair<const Key, Value>;
+
+    SpillingAggregator(std::string directory, size_t memory_budget, Combine combine = Combine{}, Hash hash = Hash{});
+    SpillingAggregator(const SpillingAggregator<Key, Value, Combine, Hash>& another) = delete;
+    SpillingAggregator<Key, Value, Combine, Hash>& operator=(
+            const SpillingAggregator<Key, Value, Combine, Hash>& another) = delete;
+    ~SpillingAggregator();
+
+    void add(const Key& key, const Value& value);
+
+    template<typename Function>
+    void finish(Function function);
+
+    size_t spill_count() const;
+    size_t spilled_records() const;
+
+private:
+    SpillingAggregator(std::string prefix, size_t memory_budget, Combine combine, Hash hash, size_t depth);
+
+    static std::string reserve_prefix(const std::string& directory);
+    size_t partition_of(const Key& key) const;
+    std::string partition_path(size_t index) const;
+    void spill();
+    void remove_files();
+
+private:
+    std::string prefix_;
+    size_t memory_budget_;
+    Combine combine_;
+    Hash hasher_;
+    size_t depth_;
+    size_t spill_count_;
+    size_t spilled_records_;
+    std::unique_ptr<HashMap<Key, Value, Hash>> groups_;
+    std::vector<std::unique_ptr<std::ofstream>> partitions_;
+
+};
+
+template<typename Key, typename Value, typename Combine, typename Hash>
+SpillingAggregator<Key, Value, Combine, Hash>::SpillingAggregator(std::string directory, size_t memory_budget,
+                                                                  Combine combine, Hash hash)
+    : SpillingAggregator(reserve_prefix(directory), memory_budget, std::move(combine), std::move(hash), 0)
+{}
+
+template<typename Key, typename Value, typename Combine, typename Hash>
+SpillingAggregator<Key, Value, Combine, Hash>::SpillingAggregator(std::string prefix, size_t memory_budget,
+                                                                  Combine combine, Hash hash, size_t depth)
+    : prefix_(std::move(prefix))
+    , memory_budget_(memory_budget)
+    , combine_(std::move(combine))
+    , hasher_(hash)
+    , depth_(depth)
+    , spill_count_(0)
+    , spilled_records_(0)
+    , groups_(std::make_unique<HashMap<Key, Value, Hash>>(hash))
+{
+    static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Value>,
+                  "spilling requires trivially copyable keys and values");
+}
+
+template<typename Key, typename Value, typename Combine, typename Hash>
+SpillingAggregator<Key, Value, Combine, Hash>::~SpillingAggregator() {
+    remove_files();
+    if (depth_ == 0) {
+        std::remove(prefix_.c_str());
+    }
+}
+
+// The reserved file claims the prefix for this aggregator and every child it recurses into.
+template<typename Key, typename Value, typename Combine, typename Hash>
+std::string SpillingAggregator<Key, Value, Combine, Hash>::reserve_prefix(const std::string& directory) {
+    std::string reserved = directory + "/aggregate-XXXXXX";
+    int fd = ::mkstemp(reserved.data());
+    if (fd < 0) {
+        throw std::runtime_error("failed to reserve spill files in " + directory);
+    }
+    ::close(fd);
+    return reserved;
+}
+
+template<typename Key, typename Value, typename Combine, typename Hash>
+void SpillingAggregator<Key, Value, Combine, Hash>::add(const Key& key, const Value& value) {
+    auto it = groups_->find(key);
+    if (it != groups_->end()) {
+        it->second = combine_(it->second, value);
+        return;
+    }
+    groups_->insert({key, value});
+    if (groups_->memory_usage() > memory_budget_ && depth_ < MAX_SPILL_DEPTH) {
+        spill();
+    }
+}
+
+template<typename Key, typename Value, typename Combine, typename Hash>
+template<typename Function>
+void SpillingAggregator<Key, Value, Combine, Hash>::finish(Function function) {
+    if (partitions_.empty()) {
+        for (const auto& node : *groups_) {
+            function(node);
+        }
+        groups_->clear();
+        return;
+    }
+
+    spill();
+    for (auto& stream : partitions_) {
+        stream->close();
+    }
+    for (size_t index = 0; index < PARTITION_FANOUT; ++index) {
+        SpillingAggregator<Key, Value, Combine, Hash> child(prefix_ + "." + std::to_string(index), memory_budget_,
+                                                            combine_, hasher_, depth_ + 1);
+        std::ifstream in(partition_path(index), std::ios::binary);
+        Key key;
+        Value value;
+        while (in.read(reinterpret_cast<char*>(&key), sizeof(Key))
+               && in.read(reinterpret_cast<char*>(&value), sizeof(Value))) {
+            child.add(key, value);
+        }
+        in.close();
+        std::remove(partition_path(index).c_str());
+        child.finish(function);
+    }
+    partitions_.clear();
+}
+
+template<typename Key, typename Value, typename Combine, typename Hash>
+size_t SpillingAggregator<Key, Value, Combine, Hash>::spill_count() const {
+    return spill_count_;
+}
+
+template<typename Key, typename Value, typename Combine, typename Hash>
+size_t SpillingAggregator<Key, Value, Combine, Hash>::spilled_records() const {
+    return spilled_records_;
+}
+
+template<typename Key, typename Value, typename Combine, typename Hash>
+size_t SpillingAggregator<Key, Value, Combine, Hash>::partition_of(const Key& key) const {
+    uint64_t hash = static_cast<uint64_t>(hasher_(key)) + depth_ * 0x9e3779b97f4a7c15ull;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash % PARTITION_FANOUT;
+}
+
+template<typename Key, typename Value, typename Combine, typename Hash>
+std::string SpillingAggregator<Key, Value, Combine, Hash>::partition_path(size_t index) const {
+    return prefix_ + "-" + std::to_string(index) + ".bin";
+}
+
+template<typename Key, typename Value, typename Combine, typename Hash>
+void SpillingAggregator<Key, Value, Combine, Hash>::spill() {
+    if (partitions_.empty()) {
+        for (size_t index = 0; index < PARTITION_FANOUT; ++index) {
+            partitions_.push_back(std::make_unique<std::ofstream>(
+                    partition_path(index), std::ios::binary | std::ios::trunc));
+            if (!*partitions_.back()) {
+                throw std::runtime_error("failed to open spill file");
+            }
+        }
+    }
+    for (const auto& node : *groups_) {
+        auto& out = *partitions_[partition_of(node.first)];
+        out.write(reinterpret_cast<const char*>(&node.first), sizeof(Key));
+        out.write(reinterpret_cast<const char*>(&node.second), sizeof(Value));
+        if (!out) {
+            throw std::runtime_error("failed to write spill file");
+        }
+    }
+    ++spill_count_;
+    spilled_records_ += groups_->size();
+    groups_ = std::make_unique<HashMap<Key, Value, Hash>>(hasher_);
+}
+
+template<typename Key, typename Value, typename Combine, typename Hash>
+void SpillingAggregator<Key, Value, Combine, Hash>::remove_files() {
+    if (partitions_.empty()) {
+        return;
+    }
+    partitions_.clear();
+    for (size_t index = 0; index < PARTITION_FANOUT; ++index) {
+        std::remove(partition_path(index).c_str());
+    }
+}
@@ -0,0 +1,313 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "hashmap.h"
+#include "snapshot.h"
+
+// Partitions are spilled as raw snapshots, so keys and values must be trivially copyable.
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class SpillingHashMap {
+private:
+    static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Value>,
+                  "spilled partitions require trivially copyable keys and values");
+
+    inline static const size_t DEFAULT_PARTITION_COUNT = 64;
+
+public:
+    using NodeType = std::pair<const Key, Value>;
+    using Partition = HashMap<Key, Value, Hash>;
+
+private:
+    struct PartitionSlot {
+        std::unique_ptr<Partition> resident;
+        size_t size = 0;
+        size_t last_access = 0;
+        bool on_disk = false;
+        bool dirty = false;
+    };
+
+public:
+    SpillingHashMap(std::string directory, size_t memory_budget,
+                    size_t partition_count = DEFAULT_PARTITION_COUNT, Hash hash = Hash{});
+    SpillingHashMap(const SpillingHashMap<Key, Value, Hash>& another) = delete;
+    SpillingHashMap<Key, Value, Hash>& operator=(const SpillingHashMap<Key, Value, Hash>& another) = delete;
+    ~SpillingHashMap();
+
+    size_t size() const;
+    bool empty() const;
+    size_t resident_bytes() const;
+    size_t memory_budget() const;
+
+    void insert(const NodeType& x);
+    void erase(const Key& key);
+    bool contains(const Key& key);
+
+    // The returned pointer/reference stays valid until the next call on the map.
+    const Value* find(const Key& key);
+    Value& operator[](const Key& key);
+    const Value& at(const Key& key);
+
+    template<typename Function>
+    void for_each(Function function);
+
+    void spill_all();
+    void clear();
+
+private:
+    size_t partition_of(const Key& key) const;
+    std::string partition_path(size_t index) const;
+    Partition& load(size_t index, bool for_write);
+    void spill(size_t index);
+    void enforce_budget(size_t keep);
+
+private:
+    Hash hasher_;
+    std::string prefix_;
+    size_t memory_budget_;
+    size_t access_clock_;
+    std::vector<PartitionSlot> partitions_;
+
+};
+
+template<typename Key, typename Value, typename Hash>
+SpillingHashMap<Key, Value, Hash>::SpillingHashMap(std::string directory, size_t memory_budget,
+                                                   size_t partition_count, Hash hash)
+    : hasher_(std::move(hash))
+    , memory_budget_(memory_budget)
+    , access_clock_(0)
+    , partitions_(partition_count == 0 ? 1 : partition_count)
+{
+    std::string reserved = directory + "/spill-XXXXXX";
+    int fd = ::mkstemp(reserved.data());
+    if (fd < 0) {
+        throw std::runtime_error("failed to reserve spill files in " + directory);
+    }
+    ::close(fd);
+    prefix_ = std::move(reserved);
+}
+
+template<typename Key, typename Value, typename Hash>
+SpillingHashMap<Key, Value, Hash>::~SpillingHashMap() {
+    for (size_t index = 0; index < partitions_.size(); ++index) {
+        if (partitions_[index].on_disk) {
+            std::remove(partition_path(index).c_str());
+        }
+    }
+    std::remove(prefix_.c_str());
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t SpillingHashMap<Key, Value, Hash>::size() const {
+    size_t total = 0;
+    for (const auto& partition : partitions_) {
+        total += partition.size;
+    }
+    return total;
+}
+
+template<typename Key, typename Value, typename Hash>
+bool SpillingHashMap<Key, Value, Hash>::empty() const {
+    return size() == 0;
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t SpillingHashMap<Key, Value, Hash>::resident_bytes() const {
+    size_t total = 0;
+    for (const auto& partition : partitions_) {
+        if (partition.resident) {
+            total += partition.resident->memory_usage();
+        }
+    }
+    return total;
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t SpillingHashMap<Key, Value, Hash>::memory_budget() const {
+    return memory_budget_;
+}
+
+template<typename Key, typename Value, typename Hash>
+void SpillingHashMap<Key, Value, Hash>::insert(const NodeType& x) {
+    size_t index = partition_of(x.first);
+    Partition& partition = load(index, true);
+    partition.insert(x);
+    partitions_[index].size = partition.size();
+    enforce_budget(index);
+}
+
+template<typename Key, typename Value, typename Hash>
+void SpillingHashMap<Key, Value, Hash>::erase(const Key& key) {
+    size_t index = partition_of(key);
+    Partition& partition = load(index, true);
+    partition.erase(key);
+    partitions_[index].size = partition.size();
+    enforce_budget(index);
+}
+
+template<typename Key, typename Value, typename Hash>
+bool SpillingHashMap<Key, Value, Hash>::contains(const Key& key) {
+    return find(key) != nullptr;
+}
+
+template<typename Key, typename Value, typename Hash>
+const Value* SpillingHashMap<Key, Value, Hash>::find(const Key& key) {
+    size_t index = partition_of(key);
+    if (partitions_[index].size == 0) {
+        return nullptr;
+    }
+    Partition& partition = load(index, false);
+    enforce_budget(index);
+    auto it = partition.find(key);
+    return it == partition.end() ? nullptr : &it->second;
+}
+
+template<typename Key, typename Value, typename Hash>
+Value& SpillingHashMap<Key, Value, Hash>::operator[](const Key& key) {
+    size_t index = partition_of(key);
+    Partition& partition = load(index, true);
+    Value& value = partition[key];
+    partitions_[index].size = partition.size();
+    enforce_budget(index);
+    return value;
+}
+
+template<typename Key, typename Value, typename Hash>
+const Value& SpillingHashMap<Key, Value, Hash>::at(const Key& key) {
+    const Value* value = find(key);
+    if (value == nullptr) {
+        throw std::out_of_range("out of range");
+    }
+    return *value;
+}
+
+template<typename Key, typename Value, typename Hash>
+template<typename Function>
+void SpillingHashMap<Key, Value, Hash>::for_each(Function function) {
+    for (size_t index = 0; index < partitions_.size(); ++index) {
+        if (partitions_[index].size == 0) {
+            continue;
+        }
+        const Partition& partition = load(index, false);
+        for (const auto& node : partition) {
+            function(node);
+        }
+        enforce_budget(index);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void SpillingHashMap<Key, Value, Hash>::spill_all() {
+    for (size_t index = 0; index < partitions_.size(); ++index) {
+        if (partitions_[index].resident) {
+            spill(index);
+        }
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void SpillingHashMap<Key, Value, Hash>::clear() {
+    for (size_t index = 0; index < partitions_.size(); ++index) {
+        auto& partition = partitions_[index];
+        if (partition.on_disk) {
+            std::remove(partition_path(index).c_str());
+        }
+        partition = PartitionSlot{};
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t SpillingHashMap<Key, Value, Hash>::partition_of(const Key& key) const {
+    uint64_t hash = static_cast<uint64_t>(hasher_(key));
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    return hash % partitions_.size();
+}
+
+template<typename Key, typename Value, typename Hash>
+std::string SpillingHashMap<Key, Value, Hash>::partition_path(size_t index) const {
+    return prefix_ + "-" + std::to_string(index) + ".bin";
+}
+
+template<typename Key, typename Value, typename Hash>
+typename SpillingHashMap<Key, Value, Hash>::Partition&
+        SpillingHashMap<Key, Value, Hash>::load(size_t index, bool for_write) {
+    auto& partition = partitions_[index];
+    partition.last_access = ++access_clock_;
+    if (!partition.resident) {
+        auto resident = std::make_unique<Partition>(hasher_);
+        if (partition.on_disk) {
+            std::ifstream in(partition_path(index), std::ios::binary);
+            if (!in) {
+                throw std::runtime_error("failed to open spilled partition");
+            }
+            read_snapshot(in, *resident);
+        }
+        partition.resident = std::move(resident);
+    }
+    partition.dirty = partition.dirty || for_write;
+    return *partition.resident;
+}
+
+template<typename Key, typename Value, typename Hash>
+void SpillingHashMap<Key, Value, Hash>::spill(size_t index) {
+    auto& partition = partitions_[index];
+    if (partition.size == 0) {
+        if (partition.on_disk) {
+            std::remove(partition_path(index).c_str());
+        }
+        partition.on_disk = false;
+    } else if (partition.dirty || !partition.on_disk) {
+        // Written aside and renamed over the old spill, so a failed write leaves the previous file intact.
+        std::string path = partition_path(index);
+        std::string spill_path = path + ".tmp";
+        try {
+            std::ofstream out(spill_path, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                throw std::runtime_error("failed to open spill file");
+            }
+            write_snapshot(out, *partition.resident);
+            out.close();
+            if (!out || std::rename(spill_path.c_str(), path.c_str()) != 0) {
+                throw std::runtime_error("failed to write spill file");
+            }
+        } catch (...) {
+            std::remove(spill_path.c_str());
+            throw;
+        }
+        partition.on_disk = true;
+    }
+    partition.dirty = false;
+    partition.resident.reset();
+}
+
+template<typename Key, typename Value, typename Hash>
+void SpillingHashMap<Key, Value, Hash>::enforce_budget(size_t keep) {
+    size_t resident = resident_bytes();
+    while (resident > memory_budget_) {
+        size_t victim = partitions_.size();
+        for (size_t index = 0; index < partitions_.size(); ++index) {
+            if (index == keep || !partitions_[index].resident) {
+                continue;
+            }
+            if (victim == partitions_.size() || partitions_[index].last_access < partitions_[victim].last_access) {
+                victim = index;
+            }
+        }
+        if (victim == partitions_.size()) {
+            return;
+        }
+        resident -= partitions_[victim].resident->memory_usage();
+        spill(victim);
+    }
+}
@@ -0,0 +1,346 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "hashmap.h"
+
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class StripedMap {
+private:
+    static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Value>,
+                  "optimistic readers copy slots word by word");
+
+    inline static const size_t DEFAULT_STRIPE_COUNT = 64;
+    inline static const size_t START_SLOT_COUNT = 16;
+    inline static const double MAX_LOAD_FACTOR = 0.5;
+    inline static const size_t KEY_WORDS = (sizeof(Key) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    inline static const size_t VALUE_WORDS = (sizeof(Value) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    inline static const size_t SLOT_WORDS = 1 + KEY_WORDS + VALUE_WORDS;
+
+public:
+    using NodeType = std::pair<const Key, Value>;
+
+private:
+    struct Table {
+        size_t slot_count;
+        std::unique_ptr<std::atomic<uint64_t>[]> words;
+
+        explicit Table(size_t slot_count);
+        std::atomic<uint64_t>* slot(size_t index) const;
+    };
+
+    struct alignas(64) Stripe {
+        std::atomic<uint64_t> version{0};
+        std::atomic<const Table*> table{nullptr};
+        std::atomic<size_t> size{0};
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Table>> tables;
+    };
+
+    class WriteGuard {
+    public:
+        explicit WriteGuard(Stripe& stripe);
+        ~WriteGuard();
+    private:
+        std::lock_guard<std::mutex> lock_;
+        Stripe& stripe_;
+    };
+
+public:
+    explicit StripedMap(size_t stripe_count = DEFAULT_STRIPE_COUNT, Hash hash = Hash{});
+    StripedMap(const StripedMap<Key, Value, Hash>& another) = delete;
+    StripedMap<Key, Value, Hash>& operator=(const StripedMap<Key, Value, Hash>& another) = delete;
+
+    bool insert(const NodeType& x);
+    void insert_or_assign(const Key& key, const Value& value);
+    bool erase(const Key& key);
+
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+
+    size_t size() const;
+    size_t stripe_count() const;
+
+private:
+    uint64_t mixed_hash(const Key& key) const;
+    Stripe& stripe_of(uint64_t mixed) const;
+    static size_t home_of(uint64_t mixed, const Table& table);
+
+    static Key load_key(const std::atomic<uint64_t>* slot);
+    static Value load_value(const std::atomic<uint64_t>* slot);
+    static void store_slot(std::atomic<uint64_t>* slot, uint64_t distance, const Key& key, const Value& value);
+    static void move_slot(std::atomic<uint64_t>* to, const std::atomic<uint64_t>* from, uint64_t distance);
+
+    static size_t probe(const Table& table, const Key& key, uint64_t mixed);
+    void place(Table& table, uint64_t mixed, Key key, Value value) const;
+    void grow(Stripe& stripe);
+
+private:
+    Hash hasher_;
+    std::unique_ptr<Stripe[]> stripes_;
+    size_t stripe_count_;
+
+};
+
+template<typename Key, typename Value, typename Hash>
+StripedMap<Key, Value, Hash>::Table::Table(size_t slot_count)
+    : slot_count(slot_count)
+    , words(new std::atomic<uint64_t>[slot_count * SLOT_WORDS])
+{
+    for (size_t i = 0; i < slot_count * SLOT_WORDS; ++i) {
+        words[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+std::atomic<uint64_t>* StripedMap<Key, Value, Hash>::Table::slot(size_t index) const {
+    return words.get() + index * SLOT_WORDS;
+}
+
+template<typename Key, typename Value, typename Hash>
+StripedMap<Key, Value, Hash>::WriteGuard::WriteGuard(Stripe& stripe)
+    : lock_(stripe.mutex)
+    , stripe_(stripe)
+{
+    stripe_.version.store(stripe_.version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+template<typename Key, typename Value, typename Hash>
+StripedMap<Key, Value, Hash>::WriteGuard::~WriteGuard() {
+    stripe_.version.store(stripe_.version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+template<typename Key, typename Value, typename Hash>
+StripedMap<Key, Value, Hash>::StripedMap(size_t stripe_count, Hash hash)
+    : hasher_(std::move(hash))
+    , stripes_(new Stripe[stripe_count == 0 ? 1 : stripe_count])
+    , stripe_count_(stripe_count == 0 ? 1 : stripe_count)
+{
+    for (size_t i = 0; i < stripe_count_; ++i) {
+        stripes_[i].tables.push_back(std::make_unique<Table>(START_SLOT_COUNT));
+        stripes_[i].table.store(stripes_[i].tables.back().get(), std::memory_order_release);
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+bool StripedMap<Key, Value, Hash>::insert(const NodeType& x) {
+    uint64_t mixed = mixed_hash(x.first);
+    Stripe& stripe = stripe_of(mixed);
+    WriteGuard guard(stripe);
+    Table& table = *stripe.tables.back();
+    if (probe(table, x.first, mixed) != table.slot_count) {
+        return false;
+    }
+    if (stripe.size.load(std::memory_order_relaxed) + 1 > table.slot_count * MAX_LOAD_FACTOR) {
+        grow(stripe);
+    }
+    place(*stripe.tables.back(), mixed, x.first, x.second);
+    stripe.size.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+template<typename Key, typename Value, typename Hash>
+void StripedMap<Key, Value, Hash>::insert_or_assign(const Key& key, const Value& value) {
+    uint64_t mixed = mixed_hash(key);
+    Stripe& stripe = stripe_of(mixed);
+    WriteGuard guard(stripe);
+    Table& table = *stripe.tables.back();
+    size_t index = probe(table, key, mixed);
+    if (index != table.slot_count) {
+        std::atomic<uint64_t>* slot = table.slot(index);
+        store_slot(slot, slot[0].load(std::memory_order_relaxed), key, value);
+        return;
+    }
+    if (stripe.size.load(std::memory_order_relaxed) + 1 > table.slot_count * MAX_LOAD_FACTOR) {
+        grow(stripe);
+    }
+    place(*stripe.tables.back(), mixed, key, value);
+    stripe.size.fetch_add(1, std::memory_order_relaxed);
+}
+
+template<typename Key, typename Value, typename Hash>
+bool StripedMap<Key, Value, Hash>::erase(const Key& key) {
+    uint64_t mixed = mixed_hash(key);
+    Stripe& stripe = stripe_of(mixed);
+    WriteGuard guard(stripe);
+    Table& table = *stripe.tables.back();
+    size_t index = probe(table, key, mixed);
+    if (index == table.slot_count) {
+        return false;
+    }
+    for ( ; ; ) {
+        size_t next = (index + 1) % table.slot_count;
+        uint64_t distance = table.slot(next)[0].load(std::memory_order_relaxed);
+        if (distance <= 1) {
+            break;
+        }
+        move_slot(table.slot(index), table.slot(next), distance - 1);
+        index = next;
+    }
+    table.slot(index)[0].store(0, std::memory_order_release);
+    stripe.size.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+template<typename Key, typename Value, typename Hash>
+bool StripedMap<Key, Value, Hash>::find(const Key& key, Value& value) const {
+    uint64_t mixed = mixed_hash(key);
+    Stripe& stripe = stripe_of(mixed);
+    for ( ; ; ) {
+        uint64_t before = stripe.version.load(std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        const Table& table = *stripe.table.load(std::memory_order_acquire);
+        size_t index = probe(table, key, mixed);
+        Value found = index == table.slot_count ? Value{} : load_value(table.slot(index));
+        if (stripe.version.load(std::memory_order_relaxed) != before) {
+            continue;
+        }
+        if (index == table.slot_count) {
+            return false;
+        }
+        value = found;
+        return true;
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+bool StripedMap<Key, Value, Hash>::contains(const Key& key) const {
+    Value value;
+    return find(key, value);
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t StripedMap<Key, Value, Hash>::size() const {
+    size_t total = 0;
+    for (size_t i = 0; i < stripe_count_; ++i) {
+        total += stripes_[i].size.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t StripedMap<Key, Value, Hash>::stripe_count() const {
+    return stripe_count_;
+}
+
+template<typename Key, typename Value, typename Hash>
+uint64_t StripedMap<Key, Value, Hash>::mixed_hash(const Key& key) const {
+    return hash_mix(static_cast<uint64_t>(hasher_(key)));
+}
+
+template<typename Key, typename Value, typename Hash>
+typename StripedMap<Key, Value, Hash>::Stripe& StripedMap<Key, Value, Hash>::stripe_of(uint64_t mixed) const {
+    return stripes_[mixed % stripe_count_];
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t StripedMap<Key, Value, Hash>::home_of(uint64_t mixed, const Table& table) {
+    return (mixed >> 32 ^ mixed) % table.slot_count;
+}
+
+template<typename Key, typename Value, typename Hash>
+Key StripedMap<Key, Value, Hash>::load_key(const std::atomic<uint64_t>* slot) {
+    uint64_t words[KEY_WORDS];
+    for (size_t i = 0; i < KEY_WORDS; ++i) {
+        words[i] = slot[1 + i].load(std::memory_order_acquire);
+    }
+    Key key;
+    std::memcpy(&key, words, sizeof(Key));
+    return key;
+}
+
+template<typename Key, typename Value, typename Hash>
+Value StripedMap<Key, Value, Hash>::load_value(const std::atomic<uint64_t>* slot) {
+    uint64_t words[VALUE_WORDS];
+    for (size_t i = 0; i < VALUE_WORDS; ++i) {
+        words[i] = slot[1 + KEY_WORDS + i].load(std::memory_order_acquire);
+    }
+    Value value;
+    std::memcpy(&value, words, sizeof(Value));
+    return value;
+}
+
+template<typename Key, typename Value, typename Hash>
+void StripedMap<Key, Value, Hash>::store_slot(std::atomic<uint64_t>* slot, uint64_t distance, const Key& key, const Value& value) {
+    uint64_t words[KEY_WORDS + VALUE_WORDS] = {};
+    std::memcpy(words, &key, sizeof(Key));
+    std::memcpy(words + KEY_WORDS, &value, sizeof(Value));
+    for (size_t i = 0; i < KEY_WORDS + VALUE_WORDS; ++i) {
+        slot[1 + i].store(words[i], std::memory_order_release);
+    }
+    slot[0].store(distance, std::memory_order_release);
+}
+
+template<typename Key, typename Value, typename Hash>
+void StripedMap<Key, Value, Hash>::move_slot(std::atomic<uint64_t>* to, const std::atomic<uint64_t>* from, uint64_t distance) {
+    for (size_t i = 1; i < SLOT_WORDS; ++i) {
+        to[i].store(from[i].load(std::memory_order_relaxed), std::memory_order_release);
+    }
+    to[0].store(distance, std::memory_order_release);
+}
+
+template<typename Key, typename Value, typename Hash>
+size_t StripedMap<Key, Value, Hash>::probe(const Table& table, const Key& key, uint64_t mixed) {
+    size_t index = home_of(mixed, table);
+    for (uint64_t distance = 1; distance <= table.slot_count; ++distance) {
+        uint64_t stored = table.slot(index)[0].load(std::memory_order_acquire);
+        if (stored < distance) {
+            break;
+        }
+        if (load_key(table.slot(index)) == key) {
+            return index;
+        }
+        index = (index + 1) % table.slot_count;
+    }
+    return table.slot_count;
+}
+
+template<typename Key, typename Value, typename Hash>
+void StripedMap<Key, Value, Hash>::place(Table& table, uint64_t mixed, Key key, Value value) const {
+    size_t index = home_of(mixed, table);
+    uint64_t distance = 1;
+    for ( ; ; ) {
+        std::atomic<uint64_t>* slot = table.slot(index);
+        uint64_t stored = slot[0].load(std::memory_order_relaxed);
+        if (stored == 0) {
+            store_slot(slot, distance, key, value);
+            return;
+        }
+        if (stored < distance) {
+            Key displaced_key = load_key(slot);
+            Value displaced_value = load_value(slot);
+            store_slot(slot, distance, key, value);
+            key = displaced_key;
+            value = displaced_value;
+            distance = stored;
+        }
+        index = (index + 1) % table.slot_count;
+        ++distance;
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+void StripedMap<Key, Value, Hash>::grow(Stripe& stripe) {
+    const Table& previous = *stripe.tables.back();
+    auto next = std::make_unique<Table>(previous.slot_count * 2);
+    for (size_t i = 0; i < previous.slot_count; ++i) {
+        const std::atomic<uint64_t>* slot = previous.slot(i);
+        if (slot[0].load(std::memory_order_relaxed) != 0) {
+            Key key = load_key(slot);
+            place(*next, mixed_hash(key), key, load_value(slot));
+        }
+    }
+    stripe.table.store(next.get(), std::memory_order_release);
+    stripe.tables.push_back(std::move(next));
+}
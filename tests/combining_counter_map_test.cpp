@@ -0,0 +1,73 @@
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "../combining_counter_map.h"
+
+namespace {
+
+const size_t THREAD_COUNT = 4;
+const uint64_t KEY_COUNT = 1000;
+const uint64_t ROUNDS = 50;
+const size_t FLUSH_THRESHOLD = 64;
+
+using Counters = CombiningCounterMap<uint64_t>;
+
+void check_totals(const Counters::Map& totals, int64_t per_key) {
+    CHECK(totals.size() == KEY_COUNT);
+    for (uint64_t key = 0; key < KEY_COUNT; ++key) {
+        CHECK(totals.at(key) == per_key);
+    }
+}
+
+void check_concurrent_adds() {
+    Counters counters(FLUSH_THRESHOLD);
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < THREAD_COUNT; ++thread) {
+        threads.emplace_back([&counters] {
+            for (uint64_t round = 0; round < ROUNDS; ++round) {
+                for (uint64_t key = 0; key < KEY_COUNT; ++key) {
+                    counters.add(key);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    int64_t expected = static_cast<int64_t>(THREAD_COUNT * ROUNDS);
+    check_totals(counters.snapshot(), expected);
+    counters.flush();
+    check_totals(counters.snapshot(), expected);
+}
+
+// Deltas a thread buffered before exiting are only merged by the flush that retires its buffer,
+// and must not be merged again by a later one.
+void check_retired_buffer() {
+    Counters counters(KEY_COUNT * 2);
+    std::thread writer([&counters] {
+        for (uint64_t key = 0; key < KEY_COUNT; ++key) {
+            counters.add(key, 3);
+        }
+    });
+    writer.join();
+    check_totals(counters.snapshot(), 3);
+    counters.flush();
+    check_totals(counters.snapshot(), 3);
+    counters.add(0, 1);
+    counters.flush();
+    counters.flush();
+    Counters::Map totals = counters.snapshot();
+    CHECK(totals.at(0) == 4);
+    CHECK(totals.at(KEY_COUNT - 1) == 3);
+}
+
+}  // namespace
+
+int main() {
+    check_concurrent_adds();
+    check_retired_buffer();
+    std::cout << "combining_counter_map_test: ok\n";
+}
@@ -0,0 +1,59 @@
+#include <cstdint>
+#include <iostream>
+
+#include "check.h"
+#include "../extendible_hashmap.h"
+
+namespace {
+
+const uint64_t KEY_COUNT = 20000;
+const uint64_t WEAK_KEY_COUNT = 2000;
+
+struct TwoValueHash {
+    size_t operator()(uint64_t key) const {
+        return key & 1;
+    }
+};
+
+// Keys whose hashes cannot be separated by splitting land in an oversized segment instead.
+void check_weak_hash() {
+    ExtendibleHashMap<uint64_t, uint64_t, TwoValueHash> map;
+    for (uint64_t key = 0; key < WEAK_KEY_COUNT; ++key) {
+        map.insert({key, key * 3});
+    }
+    CHECK(map.size() == WEAK_KEY_COUNT);
+    for (uint64_t key = 0; key < WEAK_KEY_COUNT; key += 2) {
+        map.erase(key);
+    }
+    for (uint64_t key = 0; key < WEAK_KEY_COUNT; ++key) {
+        CHECK((map.find(key) != map.end()) == (key % 2 == 1));
+    }
+    size_t visited = 0;
+    for (const auto& node : map) {
+        CHECK(node.second == node.first * 3);
+        ++visited;
+    }
+    CHECK(visited == WEAK_KEY_COUNT / 2);
+}
+
+void check_split_and_reclaim() {
+    ExtendibleHashMap<uint64_t, uint64_t> map;
+    for (uint64_t key = 0; key < KEY_COUNT; ++key) {
+        map.insert({key, key});
+    }
+    CHECK(map.segment_count() > 1);
+    size_t retained = map.memory_usage();
+    map.reclaim();
+    CHECK(map.memory_usage() < retained);
+    for (uint64_t key = 0; key < KEY_COUNT; ++key) {
+        CHECK(map.at(key) == key);
+    }
+}
+
+}  // namespace
+
+int main() {
+    check_weak_hash();
+    check_split_and_reclaim();
+    std::cout << "extendible_hashmap_test: ok\n";
+}
@@ -0,0 +1,109 @@
+#include <cstdint>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "check.h"
+#include "../hashmap.h"
+
+namespace {
+
+const size_t BATCH_COUNT = 200;
+const size_t BATCH_SIZE = 1024;
+const size_t PARALLEL_KEY_COUNT = 1 << 18;
+const size_t PARALLEL_THREADS = 4;
+const uint64_t CLUSTER_COUNT = 4096;
+
+// Many keys per hash value build long probe runs, so some cross the range boundaries of a
+// parallel rehash and have to be placed serially afterwards.
+struct ClusteredHash {
+    size_t operator()(uint64_t key) const {
+        return key % CLUSTER_COUNT;
+    }
+};
+
+// A batch insert reserves room for the batch, which must still grow the table geometrically:
+// resizing to exactly the load limit would rehash again on every following batch.
+void check_batch_insert_rehash_count() {
+    HashMap<uint64_t, uint64_t> single;
+    HashMap<uint64_t, uint64_t> batched;
+    std::vector<std::pair<const uint64_t, uint64_t>> batch;
+    for (size_t round = 0; round < BATCH_COUNT; ++round) {
+        batch.clear();
+        for (size_t i = 0; i < BATCH_SIZE; ++i) {
+            uint64_t key = round * BATCH_SIZE + i;
+            batch.emplace_back(key, key);
+            single.insert({key, key});
+        }
+        batched.insert(batch.begin(), batch.end());
+    }
+    CHECK(batched.size() == BATCH_COUNT * BATCH_SIZE);
+    CHECK(batched.stats().rehash_count <= single.stats().rehash_count + 1);
+    for (uint64_t key = 0; key < BATCH_COUNT * BATCH_SIZE; ++key) {
+        CHECK(batched.at(key) == key);
+    }
+}
+
+void check_digest_follows_iterator_writes() {
+    HashMap<uint64_t, uint64_t> written;
+    HashMap<uint64_t, uint64_t> expected;
+    written.enable_digest();
+    expected.enable_digest();
+    for (uint64_t key = 0; key < BATCH_SIZE; ++key) {
+        written.insert({key, key});
+        expected.insert({key, key});
+    }
+    uint64_t total = 0;
+    for (auto it = written.cbegin(); it != written.cend(); ++it) {
+        total += it->second;
+    }
+    CHECK(total == BATCH_SIZE * (BATCH_SIZE - 1) / 2);
+    CHECK(written.digest() == expected.digest());
+
+    written.begin()->second += 1;
+    CHECK(written.digest() != expected.digest());
+    for (auto& node : written) {
+        node.second = node.first * 2;
+    }
+    for (auto& node : expected) {
+        node.second = node.first * 2;
+    }
+    CHECK(written.digest() == expected.digest());
+    CHECK(written == expected);
+
+    written.extract_if([](const auto& node) { return node.first % 2 == 0; });
+    expected.extract_if([](const auto& node) { return node.first % 2 == 0; });
+    CHECK(written.size() == BATCH_SIZE / 2);
+    CHECK(written.digest() == expected.digest());
+}
+
+void check_parallel_rehash() {
+    WorkStealingPool pool(PARALLEL_THREADS);
+    set_default_executor(&pool);
+    HashMap<uint64_t, uint64_t, ClusteredHash> map;
+    for (uint64_t key = 0; key < PARALLEL_KEY_COUNT; ++key) {
+        map.insert({key, key + 1});
+    }
+    CHECK(map.check_invariants());
+    map.reserve(PARALLEL_KEY_COUNT * 3);
+    CHECK(map.check_invariants());
+    set_default_executor(nullptr);
+
+    CHECK(map.size() == PARALLEL_KEY_COUNT);
+    for (uint64_t key = 0; key < PARALLEL_KEY_COUNT; ++key) {
+        CHECK(map.at(key) == key + 1);
+    }
+    for (uint64_t key = 0; key < PARALLEL_KEY_COUNT; key += 2) {
+        map.erase(key);
+    }
+    CHECK(map.check_invariants());
+}
+
+}  // namespace
+
+int main() {
+    check_batch_insert_rehash_count();
+    check_digest_follows_iterator_writes();
+    check_parallel_rehash();
+    std::cout << "hashmap_test: ok\n";
+}
@@ -0,0 +1,157 @@
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "../partitioner.h"
+
+namespace {
+
+const size_t OLD_PROCESS_COUNT = 3;
+const size_t NEW_PROCESS_COUNT = 4;
+const uint64_t KEY_COUNT = 60000;
+
+struct Record {
+    uint64_t destination;
+    uint64_t key;
+    uint64_t value;
+};
+
+void write_all(int fd, const void* data, size_t bytes) {
+    const char* cursor = static_cast<const char*>(data);
+    while (bytes > 0) {
+        ssize_t written = ::write(fd, cursor, bytes);
+        if (written <= 0) {
+            throw std::runtime_error("socket write failed");
+        }
+        cursor += written;
+        bytes -= static_cast<size_t>(written);
+    }
+}
+
+void read_all(int fd, void* data, size_t bytes) {
+    char* cursor = static_cast<char*>(data);
+    while (bytes > 0) {
+        ssize_t received = ::read(fd, cursor, bytes);
+        if (received <= 0) {
+            throw std::runtime_error("socket read failed");
+        }
+        cursor += received;
+        bytes -= static_cast<size_t>(received);
+    }
+}
+
+void send_records(int fd, const std::vector<Record>& records) {
+    uint64_t count = records.size();
+    write_all(fd, &count, sizeof(count));
+    write_all(fd, records.data(), records.size() * sizeof(Record));
+}
+
+std::vector<Record> receive_records(int fd) {
+    uint64_t count;
+    read_all(fd, &count, sizeof(count));
+    std::vector<Record> records(count);
+    read_all(fd, records.data(), records.size() * sizeof(Record));
+    return records;
+}
+
+// Owns one partition: loads its share under the old layout, ships the entries that move, and
+// checks that it holds exactly its share of the new layout afterwards.
+int run_process(size_t self, int fd) {
+    Partitioner<uint64_t> before(OLD_PROCESS_COUNT);
+    Partitioner<uint64_t> after(NEW_PROCESS_COUNT);
+    HashMap<uint64_t, uint64_t> local;
+    if (self < OLD_PROCESS_COUNT) {
+        for (uint64_t key = 0; key < KEY_COUNT; ++key) {
+            if (before.partition_of(key) == self) {
+                local.insert({key, key * 3});
+            }
+        }
+    }
+
+    std::vector<Record> outgoing;
+    auto moving = reshard(local, self, after);
+    for (size_t destination = 0; destination < moving.size(); ++destination) {
+        for (const auto& node : moving[destination]) {
+            outgoing.push_back(Record{destination, node.first, node.second});
+        }
+    }
+    send_records(fd, outgoing);
+    for (const Record& record : receive_records(fd)) {
+        local.insert({record.key, record.value});
+    }
+
+    for (const auto& node : local) {
+        if (after.partition_of(node.first) != self || node.second != node.first * 3) {
+            return 1;
+        }
+    }
+    uint64_t summary[2] = {local.size(), outgoing.size()};
+    write_all(fd, summary, sizeof(summary));
+    return 0;
+}
+
+void test_reshard_across_processes() {
+    std::vector<int> sockets;
+    std::vector<pid_t> children;
+    for (size_t self = 0; self < NEW_PROCESS_COUNT; ++self) {
+        int pair[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+            throw std::runtime_error("socketpair failed");
+        }
+        pid_t child = ::fork();
+        if (child == 0) {
+            ::close(pair[0]);
+            int status = 1;
+            try {
+                status = run_process(self, pair[1]);
+            } catch (...) {
+            }
+            ::_exit(status);
+        }
+        ::close(pair[1]);
+        sockets.push_back(pair[0]);
+        children.push_back(child);
+    }
+
+    std::vector<std::vector<Record>> routed(NEW_PROCESS_COUNT);
+    for (int fd : sockets) {
+        for (const Record& record : receive_records(fd)) {
+            routed[record.destination].push_back(record);
+        }
+    }
+    for (size_t self = 0; self < NEW_PROCESS_COUNT; ++self) {
+        send_records(sockets[self], routed[self]);
+    }
+
+    uint64_t total = 0;
+    uint64_t moved = 0;
+    for (int fd : sockets) {
+        uint64_t summary[2];
+        read_all(fd, summary, sizeof(summary));
+        total += summary[0];
+        moved += summary[1];
+        ::close(fd);
+    }
+    for (pid_t child : children) {
+        int status;
+        ::waitpid(child, &status, 0);
+        CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    CHECK(total == KEY_COUNT);
+    // Growing from 3 to 4 partitions should move about a quarter of the keys, not most of them.
+    CHECK(moved > KEY_COUNT / 5 && moved < KEY_COUNT / 3);
+    std::cout << "reshard: moved " << moved << " of " << KEY_COUNT << " keys\n";
+}
+
+}  // namespace
+
+int main() {
+    test_reshard_across_processes();
+    std::cout << "partitioner_reshard_test: ok\n";
+}
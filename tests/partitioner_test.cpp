@@ -0,0 +1,55 @@
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "check.h"
+#include "../partitioner.h"
+
+namespace {
+
+const size_t PARTITION_COUNT = 8;
+const size_t KEY_COUNT = 400000;
+const size_t BUCKET_RANGES = 64;
+const double MAX_RANGE_SKEW = 0.25;
+
+// HashMap places a key by the high bits of hash_mix(hash), so a partition's keys must spread
+// evenly over those bits for its buckets to fill evenly.
+void check_bucket_occupancy(PartitionScheme scheme) {
+    Partitioner<uint64_t> partitioner(PARTITION_COUNT, scheme);
+    std::vector<std::vector<size_t>> occupancy(PARTITION_COUNT, std::vector<size_t>(BUCKET_RANGES, 0));
+    std::vector<size_t> sizes(PARTITION_COUNT, 0);
+    std::hash<uint64_t> hasher;
+    for (uint64_t key = 0; key < KEY_COUNT; ++key) {
+        size_t partition = partitioner.partition_of(key);
+        uint64_t mixed = hash_mix(static_cast<uint64_t>(hasher(key)));
+        ++occupancy[partition][mixed >> 58];
+        ++sizes[partition];
+    }
+    for (size_t partition = 0; partition < PARTITION_COUNT; ++partition) {
+        double expected = static_cast<double>(sizes[partition]) / BUCKET_RANGES;
+        for (size_t count : occupancy[partition]) {
+            CHECK(count >= expected * (1 - MAX_RANGE_SKEW) && count <= expected * (1 + MAX_RANGE_SKEW));
+        }
+    }
+}
+
+void check_partition_balance(PartitionScheme scheme) {
+    Partitioner<uint64_t> partitioner(PARTITION_COUNT, scheme);
+    std::vector<size_t> sizes(PARTITION_COUNT, 0);
+    for (uint64_t key = 0; key < KEY_COUNT; ++key) {
+        ++sizes[partitioner.partition_of(key)];
+    }
+    for (size_t size : sizes) {
+        CHECK(size > KEY_COUNT / PARTITION_COUNT / 2);
+    }
+}
+
+}  // namespace
+
+int main() {
+    for (auto scheme : {PartitionScheme::Jump, PartitionScheme::Rendezvous, PartitionScheme::Ring}) {
+        check_partition_balance(scheme);
+        check_bucket_occupancy(scheme);
+    }
+    std::cout << "partitioner_test: ok\n";
+}
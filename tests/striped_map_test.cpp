@@ -0,0 +1,95 @@
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "../striped_map.h"
+
+namespace {
+
+const int KEY_COUNT = 4096;
+const int WRITER_COUNT = 2;
+const int ERASER_COUNT = 1;
+const int READER_COUNT = 2;
+const int ROUNDS = 20000;
+
+struct Payload {
+    int64_t key;
+    int64_t negated;
+    int64_t version;
+};
+
+Payload payload_of(int key, int64_t version) {
+    return Payload{key, -static_cast<int64_t>(key), version};
+}
+
+void test_readers_writers_erasers() {
+    StripedMap<int, Payload> map(8);
+    std::atomic<bool> stop(false);
+    std::atomic<size_t> hits(0);
+
+    std::vector<std::thread> threads;
+    for (int writer = 0; writer < WRITER_COUNT; ++writer) {
+        threads.emplace_back([&map, writer] {
+            for (int round = 0; round < ROUNDS; ++round) {
+                int key = (round * 31 + writer * 7) % KEY_COUNT;
+                map.insert_or_assign(key, payload_of(key, round));
+                map.insert({(key + 1) % KEY_COUNT, payload_of((key + 1) % KEY_COUNT, 0)});
+            }
+        });
+    }
+    for (int eraser = 0; eraser < ERASER_COUNT; ++eraser) {
+        threads.emplace_back([&map, eraser] {
+            for (int round = 0; round < ROUNDS; ++round) {
+                map.erase((round * 17 + eraser) % KEY_COUNT);
+            }
+        });
+    }
+    std::vector<std::thread> readers;
+    for (int reader = 0; reader < READER_COUNT; ++reader) {
+        readers.emplace_back([&map, &stop, &hits, reader] {
+            while (!stop.load()) {
+                for (int key = reader; key < KEY_COUNT; key += 3) {
+                    Payload payload;
+                    if (map.find(key, payload)) {
+                        CHECK(payload.key == key && payload.negated == -payload.key);
+                        CHECK(payload.version >= 0 && payload.version < ROUNDS);
+                        hits.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    map.contains(key);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    stop.store(true);
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    size_t present = 0;
+    for (int key = 0; key < KEY_COUNT; ++key) {
+        Payload payload;
+        if (map.find(key, payload)) {
+            CHECK(payload.key == key && payload.negated == -payload.key);
+            ++present;
+        }
+    }
+    CHECK(present == map.size());
+    for (int key = 0; key < KEY_COUNT; ++key) {
+        map.insert_or_assign(key, payload_of(key, 0));
+    }
+    CHECK(map.size() == static_cast<size_t>(KEY_COUNT));
+    std::cout << "striped_map: " << hits.load() << " concurrent hits\n";
+}
+
+}  // namespace
+
+int main() {
+    test_readers_writers_erasers();
+    std::cout << "striped_map_test: ok\n";
+}
@@ -0,0 +1,121 @@
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "../thread_pool.h"
+
+namespace {
+
+const size_t DEQUE_ITEMS = 200000;
+const size_t THIEF_COUNT = 3;
+
+void test_deque_push_pop_steal() {
+    WorkStealingDeque<size_t> deque;
+    std::vector<size_t> items(DEQUE_ITEMS);
+    std::iota(items.begin(), items.end(), 0);
+    std::vector<std::atomic<int>> taken(DEQUE_ITEMS);
+    for (auto& count : taken) {
+        count.store(0);
+    }
+    std::atomic<bool> done(false);
+    std::atomic<size_t> stolen(0);
+
+    std::vector<std::thread> thieves;
+    for (size_t thief = 0; thief < THIEF_COUNT; ++thief) {
+        thieves.emplace_back([&] {
+            while (!done.load() || !deque.empty()) {
+                if (size_t* item = deque.steal()) {
+                    taken[*item].fetch_add(1);
+                    stolen.fetch_add(1);
+                }
+            }
+        });
+    }
+    for (size_t index = 0; index < DEQUE_ITEMS; ++index) {
+        deque.push(&items[index]);
+        if (index % 3 == 0) {
+            if (size_t* item = deque.pop()) {
+                taken[*item].fetch_add(1);
+            }
+        }
+    }
+    while (size_t* item = deque.pop()) {
+        taken[*item].fetch_add(1);
+    }
+    done.store(true);
+    for (auto& thief : thieves) {
+        thief.join();
+    }
+    for (size_t index = 0; index < DEQUE_ITEMS; ++index) {
+        CHECK(taken[index].load() == 1);
+    }
+    std::cout << "deque: " << stolen.load() << " of " << DEQUE_ITEMS << " items stolen\n";
+}
+
+void test_parallel_for_covers_range() {
+    WorkStealingPool pool(4);
+    std::vector<std::atomic<int>> visits(100000);
+    for (auto& count : visits) {
+        count.store(0);
+    }
+    parallel_for(pool, 0, visits.size(), 64, [&](size_t begin, size_t end) {
+        for (size_t index = begin; index < end; ++index) {
+            visits[index].fetch_add(1);
+        }
+    });
+    for (auto& count : visits) {
+        CHECK(count.load() == 1);
+    }
+}
+
+void test_parallel_for_nested() {
+    WorkStealingPool pool(4);
+    std::atomic<uint64_t> sum(0);
+    parallel_for(pool, 0, 64, 1, [&](size_t begin, size_t end) {
+        for (size_t outer = begin; outer < end; ++outer) {
+            parallel_for(pool, 0, 1000, 16, [&](size_t inner_begin, size_t inner_end) {
+                sum.fetch_add(inner_end - inner_begin);
+            });
+        }
+    });
+    CHECK(sum.load() == 64 * 1000);
+}
+
+void test_parallel_for_propagates_exception() {
+    WorkStealingPool pool(4);
+    std::atomic<size_t> calls(0);
+    bool thrown = false;
+    try {
+        parallel_for(pool, 0, 10000, 10, [&](size_t begin, size_t end) {
+            calls.fetch_add(1);
+            if (begin <= 5000 && 5000 < end) {
+                throw std::runtime_error("chunk failed");
+            }
+        });
+    } catch (const std::runtime_error& error) {
+        thrown = std::string(error.what()) == "chunk failed";
+    }
+    CHECK(thrown);
+
+    std::atomic<size_t> after(0);
+    parallel_for(pool, 0, 1000, 10, [&](size_t begin, size_t end) {
+        after.fetch_add(end - begin);
+    });
+    CHECK(after.load() == 1000);
+}
+
+}  // namespace
+
+int main() {
+    test_deque_push_pop_steal();
+    test_parallel_for_covers_range();
+    test_parallel_for_nested();
+    test_parallel_for_propagates_exception();
+    std::cout << "thread_pool_test: ok\n";
+}
@@ -0,0 +1,90 @@
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "../hashmap.h"
+#include "../xor_filter.h"
+
+namespace {
+
+const uint64_t KEY_COUNT = 100000;
+const uint64_t PROBE_COUNT = 1000000;
+const double MAX_FALSE_POSITIVE_RATE = 0.006;
+
+std::vector<uint64_t> make_keys() {
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < KEY_COUNT; ++i) {
+        keys.push_back(i * 2);
+    }
+    return keys;
+}
+
+void check_no_false_negatives(const XorFilter<uint64_t>& filter) {
+    for (uint64_t i = 0; i < KEY_COUNT; ++i) {
+        CHECK(filter.contains(i * 2));
+    }
+}
+
+// 8-bit fingerprints give an expected false positive rate of 1/256.
+void check_false_positive_rate(const XorFilter<uint64_t>& filter) {
+    uint64_t false_positives = 0;
+    for (uint64_t i = 0; i < PROBE_COUNT; ++i) {
+        false_positives += filter.contains(KEY_COUNT * 2 + i * 2 + 1);
+    }
+    CHECK(static_cast<double>(false_positives) / PROBE_COUNT < MAX_FALSE_POSITIVE_RATE);
+}
+
+void check_filter_from_map() {
+    HashMap<uint64_t, uint64_t> map;
+    for (uint64_t key : make_keys()) {
+        map.insert({key, key});
+    }
+    XorFilter<uint64_t> filter = map.build_filter();
+    check_no_false_negatives(filter);
+    check_false_positive_rate(filter);
+}
+
+void check_serialization() {
+    std::vector<uint64_t> keys = make_keys();
+    XorFilter<uint64_t> filter(keys.begin(), keys.end());
+    std::stringstream stream;
+    filter.serialize(stream);
+    std::string blob = stream.str();
+
+    std::istringstream in(blob);
+    XorFilter<uint64_t> restored = XorFilter<uint64_t>::deserialize(in);
+    CHECK(restored.size_in_bytes() == filter.size_in_bytes());
+    check_no_false_negatives(restored);
+
+    // The fingerprint count is the fourth header word and must be three blocks.
+    std::string inconsistent = blob;
+    inconsistent[3 * sizeof(uint64_t)] ^= 1;
+    std::istringstream bad(inconsistent);
+    bool rejected = false;
+    try {
+        XorFilter<uint64_t>::deserialize(bad);
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    CHECK(rejected);
+
+    std::istringstream truncated(blob.substr(0, blob.size() - 1));
+    rejected = false;
+    try {
+        XorFilter<uint64_t>::deserialize(truncated);
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    CHECK(rejected);
+}
+
+}  // namespace
+
+int main() {
+    check_filter_from_map();
+    check_serialization();
+    std::cout << "xor_filter_test: ok\n";
+}
@@ -0,0 +1,364 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+template<typename T>
+class WorkStealingDeque {
+private:
+    inline static const size_t START_CAPACITY = 64;
+
+    struct Buffer {
+        size_t capacity;
+        std::unique_ptr<std::atomic<T*>[]> slots;
+
+        explicit Buffer(size_t capacity) : capacity(capacity), slots(new std::atomic<T*>[capacity]) {}
+
+        T* get(int64_t index) const {
+            return slots[static_cast<size_t>(index) & (capacity - 1)].load(std::memory_order_relaxed);
+        }
+        void put(int64_t index, T* item) {
+            slots[static_cast<size_t>(index) & (capacity - 1)].store(item, std::memory_order_relaxed);
+        }
+    };
+
+public:
+    WorkStealingDeque();
+    WorkStealingDeque(const WorkStealingDeque<T>& another) = delete;
+    WorkStealingDeque<T>& operator=(const WorkStealingDeque<T>& another) = delete;
+
+    void push(T* item);
+    T* pop();
+    T* steal();
+    bool empty() const;
+
+private:
+    Buffer* grow(Buffer* buffer, int64_t top, int64_t bottom);
+
+private:
+    std::atomic<int64_t> top_;
+    std::atomic<int64_t> bottom_;
+    std::atomic<Buffer*> buffer_;
+    std::vector<std::unique_ptr<Buffer>> buffers_;
+
+};
+
+template<typename T>
+WorkStealingDeque<T>::WorkStealingDeque()
+    : top_(0)
+    , bottom_(0)
+{
+    buffers_.push_back(std::make_unique<Buffer>(START_CAPACITY));
+    buffer_.store(buffers_.back().get(), std::memory_order_relaxed);
+}
+
+template<typename T>
+void WorkStealingDeque<T>::push(T* item) {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    int64_t top = top_.load(std::memory_order_acquire);
+    Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+    if (bottom - top > static_cast<int64_t>(buffer->capacity) - 1) {
+        buffer = grow(buffer, top, bottom);
+    }
+    buffer->put(bottom, item);
+    bottom_.store(bottom + 1, std::memory_order_release);
+}
+
+template<typename T>
+T* WorkStealingDeque<T>::pop() {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+    bottom_.store(bottom, std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_seq_cst);
+    if (top > bottom) {
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    T* item = buffer->get(bottom);
+    if (top == bottom) {
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            item = nullptr;
+        }
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return item;
+}
+
+template<typename T>
+T* WorkStealingDeque<T>::steal() {
+    int64_t top = top_.load(std::memory_order_seq_cst);
+    int64_t bottom = bottom_.load(std::memory_order_seq_cst);
+    if (top >= bottom) {
+        return nullptr;
+    }
+    T* item = buffer_.load(std::memory_order_acquire)->get(top);
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return item;
+}
+
+template<typename T>
+bool WorkStealingDeque<T>::empty() const {
+    return top_.load(std::memory_order_acquire) >= bottom_.load(std::memory_order_acquire);
+}
+
+template<typename T>
+typename WorkStealingDeque<T>::Buffer* WorkStealingDeque<T>::grow(Buffer* buffer, int64_t top, int64_t bottom) {
+    auto next = std::make_unique<Buffer>(buffer->capacity * 2);
+    for (int64_t i = top; i < bottom; ++i) {
+        next->put(i, buffer->get(i));
+    }
+    buffer_.store(next.get(), std::memory_order_release);
+    buffers_.push_back(std::move(next));
+    return buffers_.back().get();
+}
+
+class Executor {
+public:
+    virtual ~Executor() = default;
+
+    virtual void execute(std::function<void()> task) = 0;
+    virtual size_t concurrency() const = 0;
+    virtual bool try_run_one() {
+        return false;
+    }
+};
+
+class WorkStealingPool : public Executor {
+private:
+    using Task = std::function<void()>;
+
+    struct Worker {
+        WorkStealingDeque<Task> deque;
+        std::thread thread;
+    };
+
+public:
+    explicit WorkStealingPool(size_t thread_count = std::thread::hardware_concurrency());
+    WorkStealingPool(const WorkStealingPool& another) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool& another) = delete;
+    ~WorkStealingPool() override;
+
+    void execute(Task task) override;
+    size_t concurrency() const override;
+    bool try_run_one() override;
+
+private:
+    Task* take(size_t start);
+    void run(size_t index);
+
+private:
+    inline static thread_local WorkStealingPool* current_pool_ = nullptr;
+    inline static thread_local size_t current_index_ = 0;
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> pending_;
+    std::atomic<size_t> sleeping_;
+    std::atomic<bool> stopping_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Task*> injected_;
+
+};
+
+inline WorkStealingPool::WorkStealingPool(size_t thread_count)
+    : pending_(0)
+    , sleeping_(0)
+    , stopping_(false)
+{
+    thread_count = std::max<size_t>(1, thread_count);
+    for (size_t index = 0; index < thread_count; ++index) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (size_t index = 0; index < thread_count; ++index) {
+        workers_[index]->thread = std::thread([this, index] { run(index); });
+    }
+}
+
+inline WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+inline void WorkStealingPool::execute(Task task) {
+    Task* item = new Task(std::move(task));
+    pending_.fetch_add(1);
+    if (current_pool_ == this) {
+        workers_[current_index_]->deque.push(item);
+    } else {
+        std::lock_guard<std::mutex> lock(mutex_);
+        injected_.push_back(item);
+    }
+    if (sleeping_.load() != 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wake_.notify_one();
+    }
+}
+
+inline size_t WorkStealingPool::concurrency() const {
+    return workers_.size();
+}
+
+inline bool WorkStealingPool::try_run_one() {
+    Task* task = take(current_pool_ == this ? current_index_ : 0);
+    if (task == nullptr) {
+        return false;
+    }
+    std::unique_ptr<Task> owned(task);
+    (*owned)();
+    return true;
+}
+
+inline WorkStealingPool::Task* WorkStealingPool::take(size_t start) {
+    if (pending_.load() == 0) {
+        return nullptr;
+    }
+    Task* task = nullptr;
+    if (current_pool_ == this) {
+        task = workers_[current_index_]->deque.pop();
+    }
+    if (task == nullptr) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!injected_.empty()) {
+            task = injected_.front();
+            injected_.pop_front();
+        }
+    }
+    for (size_t offset = 1; task == nullptr && offset <= workers_.size(); ++offset) {
+        task = workers_[(start + offset) % workers_.size()]->deque.steal();
+    }
+    if (task != nullptr) {
+        pending_.fetch_sub(1);
+    }
+    return task;
+}
+
+inline void WorkStealingPool::run(size_t index) {
+    current_pool_ = this;
+    current_index_ = index;
+    for ( ; ; ) {
+        if (try_run_one()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (stopping_ && pending_.load() == 0) {
+            return;
+        }
+        sleeping_.fetch_add(1);
+        wake_.wait(lock, [this] { return pending_.load() != 0 || stopping_; });
+        sleeping_.fetch_sub(1);
+    }
+}
+
+inline Executor& embedded_executor() {
+    static WorkStealingPool pool;
+    return pool;
+}
+
+inline std::atomic<Executor*>& default_executor_slot() {
+    static std::atomic<Executor*> executor{nullptr};
+    return executor;
+}
+
+inline void set_default_executor(Executor* executor) {
+    default_executor_slot().store(executor);
+}
+
+inline Executor& default_executor() {
+    Executor* executor = default_executor_slot().load();
+    return executor != nullptr ? *executor : embedded_executor();
+}
+
+template<typename Function>
+struct ParallelForState {
+    Executor& executor;
+    Function function;
+    size_t grain;
+    std::atomic<size_t> remaining;
+    std::atomic<size_t> spawned;
+    std::atomic<bool> waiting;
+    std::atomic<bool> failed;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable done;
+
+    ParallelForState(Executor& executor, Function function, size_t grain, size_t remaining)
+        : executor(executor), function(std::move(function)), grain(grain), remaining(remaining), spawned(0), waiting(false), failed(false) {}
+};
+
+template<typename Function>
+void parallel_for_range(const std::shared_ptr<ParallelForState<Function>>& state, size_t begin, size_t end) {
+    while (end - begin > state->grain) {
+        size_t middle = begin + (end - begin) / 2;
+        state->executor.execute([state, middle, end] { parallel_for_range(state, middle, end); });
+        state->spawned.fetch_add(1);
+        if (state->waiting.load()) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->done.notify_all();
+        }
+        end = middle;
+    }
+    if (!state->failed.load()) {
+        try {
+            state->function(begin, end);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (!state->failed.exchange(true)) {
+                state->error = std::current_exception();
+            }
+        }
+    }
+    if (state->remaining.fetch_sub(end - begin) == end - begin) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->done.notify_all();
+    }
+}
+
+template<typename Function>
+void parallel_for(Executor& executor, size_t begin, size_t end, size_t grain, Function function) {
+    if (begin >= end) {
+        return;
+    }
+    if (grain == 0) {
+        grain = std::max<size_t>(1, (end - begin) / (executor.concurrency() * 8));
+    }
+    auto state = std::make_shared<ParallelForState<Function>>(executor, std::move(function), grain, end - begin);
+    parallel_for_range(state, begin, end);
+    while (state->remaining.load() != 0) {
+        size_t spawned = state->spawned.load();
+        if (executor.try_run_one()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->waiting.store(true);
+        state->done.wait(lock, [&state, spawned] {
+            return state->remaining.load() == 0 || state->spawned.load() != spawned;
+        });
+        state->waiting.store(false);
+    }
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+template<typename Function>
+void parallel_for(size_t begin, size_t end, size_t grain, Function function) {
+    parallel_for(default_executor(), begin, end, grain, std::move(function));
+}
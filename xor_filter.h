@@ -0,0 +1,225 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+#include "hash_mix.h"
+
+template<typename Key, typename Hash = std::hash<Key>>
+class XorFilter {
+private:
+    inline static const uint64_t MAGIC = 0x3952304658524f58ull;
+    inline static const size_t MAX_BUILD_ATTEMPTS = 100;
+
+public:
+    XorFilter(Hash hash = Hash{});
+    XorFilter(std::vector<uint64_t> key_hashes, Hash hash = Hash{});
+
+    template<typename TIterator>
+    XorFilter(TIterator begin, TIterator end, Hash hash = Hash{});
+
+    bool contains(const Key& key) const;
+
+    size_t size_in_bytes() const;
+
+    void serialize(std::ostream& out) const;
+    static XorFilter<Key, Hash> deserialize(std::istream& in, Hash hash = Hash{});
+
+private:
+    static uint64_t rotl(uint64_t x, int shift);
+    static uint32_t reduce(uint32_t x, uint32_t range);
+    static uint8_t fingerprint(uint64_t hash);
+
+    size_t slot(uint64_t hash, size_t index) const;
+    void build(std::vector<uint64_t> key_hashes);
+    bool try_build(const std::vector<uint64_t>& key_hashes);
+
+private:
+    Hash hasher_;
+    uint64_t seed_;
+    uint32_t block_length_;
+    std::vector<uint8_t> fingerprints_;
+
+};
+
+template<typename Key, typename Hash>
+XorFilter<Key, Hash>::XorFilter(Hash hash)
+    : hasher_(std::move(hash))
+    , seed_(0)
+    , block_length_(0)
+{}
+
+template<typename Key, typename Hash>
+XorFilter<Key, Hash>::XorFilter(std::vector<uint64_t> key_hashes, Hash hash)
+    : XorFilter(std::move(hash))
+{
+    build(std::move(key_hashes));
+}
+
+template<typename Key, typename Hash>
+template<typename TIterator>
+XorFilter<Key, Hash>::XorFilter(TIterator begin, TIterator end, Hash hash)
+    : XorFilter(std::move(hash))
+{
+    std::vector<uint64_t> key_hashes;
+    for (auto it = begin; it != end; ++it) {
+        key_hashes.push_back(hasher_(*it));
+    }
+    build(std::move(key_hashes));
+}
+
+template<typename Key, typename Hash>
+bool XorFilter<Key, Hash>::contains(const Key& key) const {
+    if (fingerprints_.empty()) {
+        return false;
+    }
+    uint64_t hash = hash_mix(static_cast<uint64_t>(hasher_(key)) + seed_);
+    uint8_t expected = fingerprint(hash);
+    return expected == (fingerprints_[slot(hash, 0)] ^ fingerprints_[slot(hash, 1)] ^ fingerprints_[slot(hash, 2)]);
+}
+
+template<typename Key, typename Hash>
+size_t XorFilter<Key, Hash>::size_in_bytes() const {
+    return fingerprints_.size();
+}
+
+template<typename Key, typename Hash>
+void XorFilter<Key, Hash>::serialize(std::ostream& out) const {
+    uint64_t header[4] = {MAGIC, seed_, block_length_, fingerprints_.size()};
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(fingerprints_.data()), fingerprints_.size());
+    if (!out) {
+        throw std::runtime_error("failed to write filter");
+    }
+}
+
+template<typename Key, typename Hash>
+XorFilter<Key, Hash> XorFilter<Key, Hash>::deserialize(std::istream& in, Hash hash) {
+    uint64_t header[4];
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != MAGIC) {
+        throw std::runtime_error("bad filter header");
+    }
+    if (header[2] > std::numeric_limits<uint32_t>::max() || header[3] != header[2] * 3) {
+        throw std::runtime_error("inconsistent filter size");
+    }
+    XorFilter<Key, Hash> filter(std::move(hash));
+    filter.seed_ = header[1];
+    filter.block_length_ = static_cast<uint32_t>(header[2]);
+    filter.fingerprints_.resize(static_cast<size_t>(header[3]));
+    if (!in.read(reinterpret_cast<char*>(filter.fingerprints_.data()), filter.fingerprints_.size())) {
+        throw std::runtime_error("truncated filter");
+    }
+    return filter;
+}
+
+template<typename Key, typename Hash>
+uint64_t XorFilter<Key, Hash>::rotl(uint64_t x, int shift) {
+    if (shift == 0) {
+        return x;
+    }
+    return (x << shift) | (x >> (64 - shift));
+}
+
+template<typename Key, typename Hash>
+uint32_t XorFilter<Key, Hash>::reduce(uint32_t x, uint32_t range) {
+    return static_cast<uint32_t>((static_cast<uint64_t>(x) * range) >> 32);
+}
+
+template<typename Key, typename Hash>
+uint8_t XorFilter<Key, Hash>::fingerprint(uint64_t hash) {
+    return static_cast<uint8_t>(hash ^ (hash >> 32));
+}
+
+template<typename Key, typename Hash>
+size_t XorFilter<Key, Hash>::slot(uint64_t hash, size_t index) const {
+    uint32_t part = static_cast<uint32_t>(rotl(hash, 21 * static_cast<int>(index)));
+    return reduce(part, block_length_) + index * block_length_;
+}
+
+template<typename Key, typename Hash>
+void XorFilter<Key, Hash>::build(std::vector<uint64_t> key_hashes) {
+    std::sort(key_hashes.begin(), key_hashes.end());
+    key_hashes.erase(std::unique(key_hashes.begin(), key_hashes.end()), key_hashes.end());
+    if (key_hashes.empty()) {
+        return;
+    }
+
+    size_t capacity = 32 + static_cast<size_t>(1.23 * key_hashes.size());
+    block_length_ = static_cast<uint32_t>(capacity / 3);
+
+    uint64_t seed_state = 0x9e3779b97f4a7c15ull;
+    for (size_t attempt = 0; attempt < MAX_BUILD_ATTEMPTS; ++attempt) {
+        seed_state += 0x9e3779b97f4a7c15ull;
+        seed_ = hash_mix(seed_state);
+        if (try_build(key_hashes)) {
+            return;
+        }
+    }
+    throw std::runtime_error("failed to build xor filter");
+}
+
+template<typename Key, typename Hash>
+bool XorFilter<Key, Hash>::try_build(const std::vector<uint64_t>& key_hashes) {
+    size_t slot_count = static_cast<size_t>(block_length_) * 3;
+    std::vector<uint64_t> xor_masks(slot_count, 0);
+    std::vector<uint32_t> counts(slot_count, 0);
+
+    for (uint64_t key_hash : key_hashes) {
+        uint64_t hash = hash_mix(key_hash + seed_);
+        for (size_t index = 0; index < 3; ++index) {
+            size_t pos = slot(hash, index);
+            xor_masks[pos] ^= hash;
+            ++counts[pos];
+        }
+    }
+
+    std::vector<size_t> queue;
+    for (size_t pos = 0; pos < slot_count; ++pos) {
+        if (counts[pos] == 1) {
+            queue.push_back(pos);
+        }
+    }
+
+    std::vector<std::pair<uint64_t, size_t>> stack;
+    stack.reserve(key_hashes.size());
+    while (!queue.empty()) {
+        size_t pos = queue.back();
+        queue.pop_back();
+        if (counts[pos] != 1) {
+            continue;
+        }
+        uint64_t hash = xor_masks[pos];
+        stack.emplace_back(hash, pos);
+        for (size_t index = 0; index < 3; ++index) {
+            size_t other = slot(hash, index);
+            xor_masks[other] ^= hash;
+            if (--counts[other] == 1) {
+                queue.push_back(other);
+            }
+        }
+    }
+
+    if (stack.size() != key_hashes.size()) {
+        return false;
+    }
+
+    fingerprints_.assign(slot_count, 0);
+    for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+        uint64_t hash = it->first;
+        size_t pos = it->second;
+        uint8_t value = fingerprint(hash);
+        for (size_t index = 0; index < 3; ++index) {
+            size_t other = slot(hash, index);
+            if (other != pos) {
+                value ^= fingerprints_[other];
+            }
+        }
+        fingerprints_[pos] = value;
+    }
+    return true;
+}